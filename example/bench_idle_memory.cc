@@ -0,0 +1,144 @@
+// 测量空闲连接的常驻内存占用
+// 用法: ./bench_idle_memory [连接数=10000] [IO线程数=4] [noshrink]
+// 每个客户端连接发送一条小消息并收到回复后保持空闲, 统计每个空闲连接占用的 RSS;
+// 传入 noshrink 时关闭缓冲区排空后归还存储区的策略, 用于对比
+#include <arpa/inet.h>
+#include <atomic>
+#include <mutex>
+#include <mymuduo/Logger.h>
+#include <mymuduo/TcpServer.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static const uint16_t kPort = 9981;
+
+// 读取当前进程的常驻内存(字节)
+static long residentBytes()
+{
+    long pages = 0, resident = 0;
+    FILE* fp = ::fopen("/proc/self/statm", "r");
+    if (fp)
+    {
+        if (::fscanf(fp, "%ld %ld", &pages, &resident) != 2)
+        {
+            resident = 0;
+        }
+        ::fclose(fp);
+    }
+    return resident * ::sysconf(_SC_PAGESIZE);
+}
+
+int main(int argc, char* argv[])
+{
+    int numConns = argc > 1 ? ::atoi(argv[1]) : 10000;
+    int numThreads = argc > 2 ? ::atoi(argv[2]) : 4;
+    bool shrink = !(argc > 3 && ::strcmp(argv[3], "noshrink") == 0);
+
+    std::atomic_int connected(0);
+    std::atomic_bool ready(false);
+    EventLoop* baseLoop = nullptr;
+    std::mutex mutex;
+    std::vector<EventLoop*> loops;
+
+    std::thread serverThread(
+        [&]()
+        {
+            EventLoop loop;
+            TcpServer server(&loop, InetAddress(kPort), "IdleBench");
+            server.setThreadNum(numThreads);
+            server.setShrinkBuffersWhenDrained(shrink);
+            server.setThreadInitcallback(
+                [&](EventLoop* ioLoop)
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    loops.push_back(ioLoop);
+                });
+            server.setConnectionCallback(
+                [&](const TcpConnectionPtr& conn)
+                {
+                    if (conn->connected())
+                    {
+                        ++connected;
+                    }
+                });
+            server.setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+                                      { conn->send(buf->retrieveAllAsString()); });
+            server.start();
+            baseLoop = &loop;
+            ready = true;
+            loop.loop();
+        });
+    while (!ready)
+    {
+        ::usleep(1000);
+    }
+
+    long before = residentBytes();
+
+    // 建立连接, 每个连接完成一次请求/应答后保持空闲
+    std::vector<int> clients;
+    sockaddr_in addr;
+    ::memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = ::inet_addr("127.0.0.1");
+    const char msg[] = "hello";
+    char reply[sizeof msg];
+    for (int i = 0; i < numConns; ++i)
+    {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0 || ::connect(fd, (sockaddr*)&addr, sizeof addr) < 0)
+        {
+            ::fprintf(stderr, "connect failed after %d connections (ulimit -n?)\n", i);
+            if (fd >= 0)
+            {
+                ::close(fd);
+            }
+            break;
+        }
+        if (::write(fd, msg, sizeof msg) != sizeof msg || ::read(fd, reply, sizeof reply) <= 0)
+        {
+            ::fprintf(stderr, "request failed on connection %d\n", i);
+        }
+        clients.push_back(fd);
+    }
+    while (connected < static_cast<int>(clients.size()))
+    {
+        ::usleep(1000);
+    }
+    ::sleep(1);  // 等待最后一批回复的写完成回调执行完毕
+
+    long after = residentBytes();
+    ::printf("connections: %lu  shrink: %s\n", clients.size(), shrink ? "on" : "off");
+    ::printf("rss before: %ld KB  after: %ld KB\n", before / 1024, after / 1024);
+    if (!clients.empty())
+    {
+        ::printf("rss per idle connection: %.1f bytes\n",
+                 static_cast<double>(after - before) / clients.size());
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (EventLoop* loop : loops)
+        {
+            BufferPool::Stats stats = loop->bufferPool().stats();
+            ::printf("loop %p pool: hits=%lu misses=%lu held=%lu bytes\n", loop,
+                     (unsigned long)stats.hits, (unsigned long)stats.misses,
+                     (unsigned long)stats.bytesHeld);
+        }
+    }
+
+    for (int fd : clients)
+    {
+        ::close(fd);
+    }
+    baseLoop->quit();
+    serverThread.join();
+    return 0;
+}
@@ -0,0 +1,76 @@
+// 测量跨线程投递任务(EventLoop::queueInLoop)的吞吐量
+// 用法: ./bench_post [生产者线程数=4] [每个线程投递的任务数=1000000] [每个线程最多未执行的任务数=0]
+// 第三个参数为 0 时生产者不停地投递; 大于 0 时模拟服务器的常态, 每个 loop 迭代只处理有限个回调
+// 每个任务绑定一个 shared_ptr 和两个整数, 与库内部 std::bind(&TcpConnection::xxx, shared_from_this(), ...)
+// 的大小相当; 同一份程序分别链接新旧版本的库即可对比前后的差异
+#include <atomic>
+#include <memory>
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/EventLoopThread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+struct Counter
+{
+    explicit Counter(int producers) : sum(0), executed(0), executedBy(producers) {}
+    void add(int a, int b)
+    {
+        sum += a + b;
+        ++executed;
+        executedBy[a].fetch_add(1, std::memory_order_release);
+    }
+    long sum;
+    std::atomic<long> executed;
+    std::vector<std::atomic<long>> executedBy;  // 每个生产者已被执行的任务数
+};
+
+int main(int argc, char* argv[])
+{
+    int numProducers = argc > 1 ? ::atoi(argv[1]) : 4;
+    long postsPerProducer = argc > 2 ? ::atol(argv[2]) : 1000000;
+    long window = argc > 3 ? ::atol(argv[3]) : 0;
+    long total = numProducers * postsPerProducer;
+
+    EventLoopThread loopThread;
+    EventLoop* loop = loopThread.startLoop();
+    std::shared_ptr<Counter> counter = std::make_shared<Counter>(numProducers);
+
+    Timestamp start(Timestamp::now());
+    std::vector<std::thread> producers;
+    for (int p = 0; p < numProducers; ++p)
+    {
+        producers.emplace_back(
+            [=]()
+            {
+                for (long i = 0; i < postsPerProducer; ++i)
+                {
+                    while (window > 0 && i - counter->executedBy[p].load(std::memory_order_acquire) >= window)
+                    {
+                        std::this_thread::yield();
+                    }
+                    loop->queueInLoop(std::bind(&Counter::add, counter, p, static_cast<int>(i)));
+                }
+            });
+    }
+    for (std::thread& t : producers)
+    {
+        t.join();
+    }
+    Timestamp posted(Timestamp::now());
+    while (counter->executed.load(std::memory_order_relaxed) < total)
+    {
+        ::usleep(100);
+    }
+    Timestamp done(Timestamp::now());
+
+    double postSeconds = timeDifference(posted, start);
+    double totalSeconds = timeDifference(done, start);
+    ::printf("producers: %d  posts: %ld  window: %ld  sizeof(EventLoop::Functor): %lu\n", numProducers,
+             total, window, (unsigned long)sizeof(EventLoop::Functor));
+    ::printf("post phase: %.3f s  %.0f posts/s\n", postSeconds, total / postSeconds);
+    ::printf("end to end: %.3f s  %.0f tasks/s\n", totalSeconds, total / totalSeconds);
+    return 0;
+}
\ No newline at end of file
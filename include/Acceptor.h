@@ -1,6 +1,8 @@
 #pragma once
 
+#include <atomic>
 #include <functional>
+#include <stdint.h>
 
 #include "Channel.h"
 #include "Socket.h"
@@ -15,24 +17,66 @@ class Acceptor : noncopyable
     // 新连接回调函数
     using NewConnectionCallback = std::function<void(int sockfd, const InetAddress&)>;
 
+    static const int kDefaultAcceptBatch = 16;  // 默认每次可读事件最多接受的连接数
+
+    // 统计信息快照, 可以在任意线程读取
+    struct Stats
+    {
+        uint64_t wakeups;      // 监听socket可读的次数
+        uint64_t accepted;     // 接受的连接数
+        uint64_t batchFull;    // 一次可读事件接受满 acceptBatch 个连接的次数(说明队列中可能还有连接)
+        uint64_t rejected;     // fd 耗尽时借助预留 fd 接受后立即关闭的连接数
+        uint64_t errors;       // 其他 accept 错误的次数
+    };
+
     Acceptor(EventLoop* loop, const InetAddress& listenAddr, bool reuseport);
     ~Acceptor();
 
     // 设置新连接回调函数
     void setNewConnectionCallback(const NewConnectionCallback& cb) { newConnectionCallback_ = cb; }
+    // 设置每次可读事件最多接受的连接数(读到 EAGAIN 时提前结束), 需在 listen() 之前调用
+    void setAcceptBatch(int n) { acceptBatch_ = n > 0 ? n : 1; }
+    // 获取统计信息
+    Stats stats() const;
     // 检查当前Acceptor是否在监听
     bool listenning() const { return listenning_; }
-    // 监听网络连接
+    // 所属的 EventLoop
+    EventLoop* ownerLoop() const { return loop_; }
+    // 监听网络连接并关注新连接事件, 需在所属loop中调用
     void listen();
+    // 只调用 listen 系统调用, 可以在任意线程调用; 新连接先在内核中排队, 直到所属loop调用 listen()
+    // 用于按确定的顺序加入 SO_REUSEPORT 组
+    void listenSocket();
+    // 为所在的 SO_REUSEPORT 组挂载按 CPU 分发的程序(见 Socket::setReusePortCpuSteering)
+    bool setReusePortCpuSteering(int groupSize)
+    {
+        return acceptSocket_.setReusePortCpuSteering(groupSize);
+    }
 
    private:
     // 处理读取事件(有新连接)
     void handleRead();
+    // fd 耗尽时, 释放预留的 fd 接受一个连接并立即关闭, 让它从监听队列中移除; 预留的 fd 不可用时返回 false
+    bool rejectWithReservedFd();
+
+    // 计数器只由所属loop线程写入, 其他线程只读快照, 因此用 relaxed 原子量即可
+    static void increase(std::atomic<uint64_t>& counter)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
 
    private:
-    EventLoop* loop_;        // 指向 Acceptor 所属的 EventLoop(即baseLoop/mainLoop)
+    EventLoop* loop_;        // 指向 Acceptor 所属的 EventLoop(通常为baseLoop/mainLoop, 见 TcpServer::kReusePortPerLoop)
     Socket acceptSocket_;    // 封装 listen_fd 的 Socket 对象
     Channel acceptChannel_;  // 封装 listen_fd 的 Channel 对象
     NewConnectionCallback newConnectionCallback_;  // 当有新连接要执行的回调函数
     bool listenning_;                              // 当前 Acceptor 是否正在监听端口
+    int acceptBatch_;                              // 每次可读事件最多接受的连接数
+    int idleFd_;  // 预留的 fd(打开 /dev/null), fd 耗尽时让出给 accept
+
+    std::atomic<uint64_t> wakeups_;
+    std::atomic<uint64_t> accepted_;
+    std::atomic<uint64_t> batchFull_;
+    std::atomic<uint64_t> rejected_;
+    std::atomic<uint64_t> errors_;
 };
\ No newline at end of file
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+#include "Thread.h"
+#include "noncopyable.h"
+
+class LogFile;
+
+/**
+ * AsyncLogging 是异步日志的后端
+ * - 每个写日志的线程有自己的前端缓冲区, 追加时只锁自己的缓冲区(只与后台线程竞争), 不写文件
+ * - 前端缓冲区写满时挂到本线程的待写出列表, 换上一块空闲缓冲区, 并唤醒后台线程
+ * - 后台线程每隔 flushInterval 秒(或有缓冲区写满时)把各线程的待写出列表和未满的缓冲区交换出来, 批量写入输出
+ * - 同一线程的日志保持顺序, 不同线程的日志按批次交错
+ * - 积压超过上限时丢弃多余的缓冲区, 并记录丢弃的数量, 防止内存无限增长
+ */
+class AsyncLogging : noncopyable
+{
+   public:
+    // basename 为空时输出到标准输出
+    AsyncLogging(const std::string& basename, off_t rollSize, int flushInterval);
+    ~AsyncLogging();
+
+    void start();
+    // 停止后台线程, 写出所有缓冲的日志
+    void stop();
+
+    // 追加一条日志, 后端已停止时返回 false(由调用方同步输出)
+    bool append(const char* data, size_t len);
+    // 等待后台线程写出调用前追加的所有日志
+    void flush();
+
+   private:
+    // 固定大小的日志缓冲区
+    struct LogBuffer
+    {
+        LogBuffer() : len(0) {}
+        size_t avail() const { return sizeof data - len; }
+
+        char data[64 * 1024];
+        size_t len;
+    };
+    using BufferPtr = std::unique_ptr<LogBuffer>;
+    using BufferVector = std::vector<BufferPtr>;
+
+    // 每个线程的前端缓冲区
+    struct ThreadBuffer
+    {
+        std::mutex mutex;   // 只在本线程追加和后台线程交换时加锁
+        BufferPtr current;  // 正在写入的缓冲区, 首次写日志时分配
+        BufferVector full;  // 已写满、等待写出的缓冲区(按写入顺序)
+    };
+    using ThreadBufferPtr = std::shared_ptr<ThreadBuffer>;
+
+    static const size_t kMaxBufferedBuffers = 256;  // 最多积压的缓冲区数量(16MB)
+    static const size_t kKeptOnOverflow = 16;       // 积压超限时保留的最早的缓冲区数量
+    static const size_t kMaxFreeBuffers = 16;       // 最多保留的空闲缓冲区数量
+
+    // 后台线程函数
+    void threadFunc();
+    // 当前线程的前端缓冲区, 首次调用时注册
+    ThreadBuffer& threadBuffer();
+    // 取一块空闲缓冲区, 需持有 mutex_
+    BufferPtr takeFreeBuffer();
+    // 写出一批缓冲区
+    void writeBuffers(BufferVector& buffers);
+
+    const std::string basename_;
+    const off_t rollSize_;
+    const int flushInterval_;
+    std::unique_ptr<LogFile> file_;  // 输出文件, 输出到标准输出时为空, 只由后台线程使用
+
+    std::atomic<bool> running_;
+    Thread thread_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;         // 唤醒后台线程
+    std::condition_variable flushedCond_;  // 通知 flush() 的调用方
+    bool bufferFull_;                      // 有线程的缓冲区写满, 需要尽快写出
+    BufferVector freeBuffers_;             // 空闲缓冲区
+    std::vector<ThreadBufferPtr> threadBuffers_;  // 所有注册过的线程缓冲区
+    uint64_t flushRequested_;              // flush() 请求的序号
+    uint64_t flushCompleted_;              // 后台线程已完成的 flush 序号
+    uint64_t droppedBuffers_;              // 因积压被丢弃的缓冲区数量
+};
\ No newline at end of file
@@ -0,0 +1,330 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <sys/types.h>
+#include <type_traits>
+#include <vector>
+
+#include "Thread.h"
+#include "Timestamp.h"
+#include "noncopyable.h"
+
+class LogFile;
+
+// 一个 LOG_* 调用点的静态描述, 由宏定义为函数内静态变量(常量初始化, 没有运行期开销)
+// 第一次以二进制模式写日志时分配 id, 之后的记录只写 id 和参数
+struct BinaryLogSite
+{
+    int level;
+    const char* format;  // 格式字符串(字符串字面量)
+    const char* file;
+    int line;
+    std::atomic<uint32_t> id;  // 0 表示尚未注册
+};
+
+/**
+ * BinaryLogRing 是单生产者单消费者的无锁字节环形队列, 每个写日志的线程一个
+ * - 生产者(写日志的线程)只写 tail_, 消费者(后台线程)只写 head_, 两边都不加锁
+ * - 每条记录在队列中连续存放, 按 8 字节对齐; 尾部放不下时写一条填充记录并回绕到开头
+ * - 队列满时丢弃记录并计数, 写日志的线程永远不会阻塞
+ */
+class BinaryLogRing : noncopyable
+{
+   public:
+    // 队列中的记录头
+    struct RecordHeader
+    {
+        uint32_t size;     // 整条记录(含记录头和对齐填充)的字节数
+        uint32_t siteId;   // 调用点 id, 0 表示回绕前的填充记录
+        uint32_t argsLen;  // 参数编码后的字节数
+        int64_t micros;    // 时间戳(微秒)
+    };
+
+    BinaryLogRing(size_t capacity, int tid);
+    ~BinaryLogRing();
+
+    // 生产者: 预留 size 字节的连续空间, 队列满时返回 nullptr(记为丢弃); 写好后调用 commit()
+    char* reserve(size_t size)
+    {
+        uint64_t tail = tail_.load(std::memory_order_relaxed);
+        size_t offset = static_cast<size_t>(tail & mask_);
+        size_t contiguous = capacity_ - offset;
+        // 尾部放不下时需要额外占用 contiguous 字节的填充
+        size_t need = size + (contiguous < size ? contiguous : 0);
+        if (tail + need - headCache_ > capacity_)
+        {
+            headCache_ = head_.load(std::memory_order_acquire);
+            if (tail + need - headCache_ > capacity_)
+            {
+                dropped_.store(dropped_.load(std::memory_order_relaxed) + 1,
+                               std::memory_order_relaxed);
+                return nullptr;
+            }
+        }
+        if (contiguous < size)
+        {
+            RecordHeader* padding = reinterpret_cast<RecordHeader*>(buffer_ + offset);
+            padding->size = static_cast<uint32_t>(contiguous);
+            padding->siteId = 0;
+            tail += contiguous;
+            offset = 0;
+        }
+        pendingTail_ = tail + size;
+        return buffer_ + offset;
+    }
+    void commit() { tail_.store(pendingTail_, std::memory_order_release); }
+
+    // 消费者: 依次处理队列中的所有记录, 返回处理的记录数
+    template <typename Func>
+    size_t consume(Func func)
+    {
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        uint64_t tail = tail_.load(std::memory_order_acquire);
+        size_t count = 0;
+        while (head < tail)
+        {
+            const RecordHeader* header =
+                reinterpret_cast<const RecordHeader*>(buffer_ + (head & mask_));
+            if (header->siteId != 0)
+            {
+                func(header);
+                ++count;
+            }
+            head += header->size;
+        }
+        head_.store(head, std::memory_order_release);
+        return count;
+    }
+
+    bool empty() const
+    {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+    int tid() const { return tid_; }
+    // 消费者: 返回上次调用以来新丢弃的记录数
+    uint64_t takeDropped()
+    {
+        uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+        uint64_t delta = dropped - reportedDropped_;
+        reportedDropped_ = dropped;
+        return delta;
+    }
+
+   private:
+    char* buffer_;
+    const size_t capacity_;  // 2 的幂
+    const uint64_t mask_;
+    const int tid_;  // 所属线程
+
+    // 生产者和消费者各自写的位置放在不同的缓存行, 避免伪共享
+    alignas(64) std::atomic<uint64_t> tail_;  // 已提交的写位置
+    uint64_t pendingTail_;                    // reserve() 之后、commit() 之前的写位置
+    uint64_t headCache_;                      // 生产者缓存的读位置, 只在看起来满时才重新读取
+    std::atomic<uint64_t> dropped_;           // 因队列满被丢弃的记录数
+    alignas(64) std::atomic<uint64_t> head_;  // 消费者的读位置
+    uint64_t reportedDropped_;                // 消费者已上报的丢弃数量
+};
+
+// 当前线程的环形队列, 首次写二进制日志时创建
+extern __thread BinaryLogRing* t_binaryLogRing;
+
+/**
+ * BinaryLogging 是二进制延迟格式化日志的后端
+ * - 写日志的线程只把调用点 id、时间戳和原始参数写入自己的无锁环形队列, 不调用 snprintf
+ * - 后台线程定期把各线程队列中的记录搬到滚动的二进制文件中, 每个文件开头带有格式字符串表
+ * - 由离线工具 mymuduo_logdecode 按格式字符串还原成文本
+ * - 参数按类型编码: 整数/浮点数/指针写 8 字节, C 字符串拷贝内容(最多 kMaxStringLen 字节)
+ *
+ * 文件格式(本机字节序):
+ *   文件头   kMagic(8字节)
+ *   调用点   'S' id:u32 level:u8 line:u32 formatLen:u16 format fileLen:u16 file
+ *   日志     'R' tid:u32 id:u32 micros:i64 argsLen:u32 args
+ *   丢弃     'X' tid:u32 count:u64
+ *   参数     'i' i64 | 'u' u64 | 'd' double | 'p' u64 | 's' len:u16 bytes
+ */
+class BinaryLogging : noncopyable
+{
+   public:
+    static const char kMagic[8];
+    static const size_t kMaxStringLen = 1024;
+
+    // 记录类型
+    enum RecordType
+    {
+        kSiteRecord = 'S',
+        kLogRecord = 'R',
+        kDropRecord = 'X',
+    };
+    // 参数类型
+    enum ArgType
+    {
+        kIntArg = 'i',
+        kUintArg = 'u',
+        kDoubleArg = 'd',
+        kPointerArg = 'p',
+        kStringArg = 's',
+    };
+
+    // ringBytes 为每个线程环形队列的大小(向上取整到 2 的幂)
+    BinaryLogging(const std::string& basename, size_t ringBytes, off_t rollSize);
+    ~BinaryLogging();
+
+    void start();
+    // 停止后台线程, 写出所有队列中的记录
+    void stop();
+    // 等待后台线程写出调用前提交的所有记录
+    void flush();
+
+    // 写一条二进制日志, 由 LOG_* 宏在二进制模式下调用
+    template <typename... Args>
+    static void log(BinaryLogSite* site, Args... args)
+    {
+        uint32_t id = site->id.load(std::memory_order_acquire);
+        if (__builtin_expect(id == 0, 0))
+        {
+            id = registerSite(site);
+        }
+        BinaryLogRing* ring = t_binaryLogRing;
+        if (__builtin_expect(ring == nullptr, 0))
+        {
+            ring = createThreadRing();
+            if (ring == nullptr)
+            {
+                return;  // 后端未开启
+            }
+        }
+        size_t argsLen = argsSize(args...);
+        size_t size = alignUp(sizeof(BinaryLogRing::RecordHeader) + argsLen);
+        char* buf = ring->reserve(size);
+        if (buf == nullptr)
+        {
+            return;
+        }
+        BinaryLogRing::RecordHeader* header = reinterpret_cast<BinaryLogRing::RecordHeader*>(buf);
+        header->size = static_cast<uint32_t>(size);
+        header->siteId = id;
+        header->argsLen = static_cast<uint32_t>(argsLen);
+        header->micros = Timestamp::now().microSecondsSinceEpoch();
+        encodeArgs(buf + sizeof(BinaryLogRing::RecordHeader), args...);
+        ring->commit();
+    }
+
+   private:
+    static size_t alignUp(size_t n) { return (n + 7) & ~static_cast<size_t>(7); }
+    static size_t stringLen(const char* s) { return s ? strnlen(s, kMaxStringLen) : 0; }
+
+    // 参数编码后的长度
+    template <typename T>
+    static typename std::enable_if<std::is_arithmetic<T>::value || std::is_enum<T>::value,
+                                   size_t>::type
+    argSize(T)
+    {
+        return 1 + 8;
+    }
+    static size_t argSize(const char* s) { return 1 + 2 + stringLen(s); }
+    template <typename T>
+    static size_t argSize(const T*)
+    {
+        return 1 + 8;
+    }
+    static size_t argsSize() { return 0; }
+    template <typename T, typename... Rest>
+    static size_t argsSize(T arg, Rest... rest)
+    {
+        return argSize(arg) + argsSize(rest...);
+    }
+
+    // 参数编码
+    static char* encodeTagged(char* p, char tag, const void* value)
+    {
+        *p = tag;
+        memcpy(p + 1, value, 8);
+        return p + 9;
+    }
+    template <typename T>
+    static typename std::enable_if<std::is_floating_point<T>::value, char*>::type encodeArg(char* p,
+                                                                                             T v)
+    {
+        double d = static_cast<double>(v);
+        return encodeTagged(p, kDoubleArg, &d);
+    }
+    template <typename T>
+    static typename std::enable_if<(std::is_integral<T>::value && std::is_signed<T>::value) ||
+                                       std::is_enum<T>::value,
+                                   char*>::type
+    encodeArg(char* p, T v)
+    {
+        int64_t i = static_cast<int64_t>(v);
+        return encodeTagged(p, kIntArg, &i);
+    }
+    template <typename T>
+    static typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value,
+                                   char*>::type
+    encodeArg(char* p, T v)
+    {
+        uint64_t u = static_cast<uint64_t>(v);
+        return encodeTagged(p, kUintArg, &u);
+    }
+    static char* encodeArg(char* p, const char* s)
+    {
+        uint16_t len = static_cast<uint16_t>(stringLen(s));
+        *p = kStringArg;
+        memcpy(p + 1, &len, 2);
+        if (len > 0)
+        {
+            memcpy(p + 3, s, len);
+        }
+        return p + 3 + len;
+    }
+    template <typename T>
+    static char* encodeArg(char* p, const T* ptr)
+    {
+        uint64_t u = reinterpret_cast<uintptr_t>(ptr);
+        return encodeTagged(p, kPointerArg, &u);
+    }
+    static char* encodeArgs(char* p) { return p; }
+    template <typename T, typename... Rest>
+    static char* encodeArgs(char* p, T arg, Rest... rest)
+    {
+        return encodeArgs(encodeArg(p, arg), rest...);
+    }
+
+    // 为调用点分配 id
+    static uint32_t registerSite(BinaryLogSite* site);
+    // 为当前线程创建并注册环形队列, 后端未开启时返回 nullptr
+    static BinaryLogRing* createThreadRing();
+
+    // 后台线程函数
+    void threadFunc();
+    // 把所有队列中的记录写入文件
+    void drain();
+    // 写入尚未写出的调用点
+    void writeNewSites();
+    // 新文件的文件头: 魔数和全部调用点
+    void writeFileHeader(LogFile* file);
+
+    static const int kDrainIntervalMs = 20;  // 后台线程搬运记录的间隔
+
+    const std::string basename_;
+    const off_t rollSize_;
+    const size_t ringBytes_;
+    std::unique_ptr<LogFile> file_;  // 只由后台线程使用
+    size_t sitesWritten_;            // 当前文件已写出的调用点数量
+    std::string staging_;            // 后台线程的写出缓冲区
+
+    std::atomic<bool> running_;
+    Thread thread_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::condition_variable flushedCond_;
+    std::vector<std::shared_ptr<BinaryLogRing>> rings_;  // 所有线程的环形队列
+    uint64_t flushRequested_;
+    uint64_t flushCompleted_;
+};
\ No newline at end of file
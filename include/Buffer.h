@@ -1,48 +1,121 @@
 #pragma once
 
 #include <algorithm>
+#include <deque>
 #include <string>
-#include <vector>
+#include <sys/types.h>
 
+// 连续模式(kContiguous)的内存布局:
 // +-------------------+------------------+------------------+
 // | prependable bytes |  readable bytes  |  writable bytes  |
 // |    (前置预留区)    |   (可读数据区)    |   (可写数据区)    |
 // +-------------------+------------------+------------------+
 // |                   |                  |                  |
 // 0      <=      readerIndex   <=   writerIndex    <=     size
+//
+// 分段模式(kSegmented)的内存布局: 由若干固定大小的数据块组成的链表
+// +--------------------+     +--------------------+     +--------------------+
+// | 已读 | 可读         | --> |  可读               | --> | 可读  |    可写     |
+// +--------------------+     +--------------------+     +--------------------+
+//   front segment                                          back segment
+// 追加数据只写入尾块，写满后挂上新块，不再 memmove/realloc 已有数据；
+// 发送时用 writev 一次性提交多个块
 
 class Buffer
 {
    public:
     static const size_t kCheapPrepend = 8;  // 前置预留区,大小8字节
     static const size_t kInitialSize = 1024;  // 缓冲区(readable + writable)的初始大小,大小1024字节
+    static const size_t kSegmentSize = 16 * 1024;  // 分段模式下每个数据块的大小,16KB
+    static const int kMaxIovecs = 64;              // 分段模式下单次 writev 最多提交的块数
 
-    explicit Buffer(size_t initialSize = kInitialSize)
-        : buffer_(kCheapPrepend + initialSize),  // 缓冲区总大小 = 预留区 + 初始大小
-          readerIndex_(kCheapPrepend),           // 读索引指向预留区之后
-          writerIndex_(kCheapPrepend)            // 写索引初始时与读索引相同
+    // 缓冲区存储模式
+    enum Mode
     {
-    }
+        kContiguous,  // 连续模式: 单块连续存储, peek() 零成本(默认, 适合输入缓冲区)
+        kSegmented,   // 分段模式: 数据块链表, 适合持续增长的大块输出
+    };
+
+    // 构造时不分配存储区, 首次写入数据时才从内存池按需分配(至少 kCheapPrepend + initialSize)
+    explicit Buffer(size_t initialSize = kInitialSize, Mode mode = kContiguous);
+    ~Buffer();
+
+    Buffer(const Buffer& rhs);
+    Buffer& operator=(const Buffer& rhs);
+    // 移动操作直接接管存储区和数据块, 不拷贝数据; 被移走的 Buffer 回到未分配的空状态
+    Buffer(Buffer&& rhs) noexcept;
+    Buffer& operator=(Buffer&& rhs) noexcept;
+    void swap(Buffer& rhs) noexcept;
+
+    // 返回缓冲区的存储模式
+    Mode mode() const { return mode_; }
+    bool segmented() const { return mode_ == kSegmented; }
 
     // 返回可读数据的长度
-    size_t readableBytes() const { return writerIndex_ - readerIndex_; }
-    // 返回可写空间的长度
-    size_t writableBytes() const { return buffer_.size() - writerIndex_; }
+    size_t readableBytes() const
+    {
+        return segmented() ? segmentedReadable_ : writerIndex_ - readerIndex_;
+    }
+    // 返回可写空间的长度(分段模式下为尾块剩余空间)
+    size_t writableBytes() const
+    {
+        if (segmented())
+        {
+            return segments_.empty() ? 0 : segments_.back().writableBytes();
+        }
+        return capacity_ - writerIndex_;
+    }
     // 返回前置预留区的长度
-    size_t prependableBytes() const { return readerIndex_; }
+    size_t prependableBytes() const
+    {
+        if (segmented())
+        {
+            return segments_.empty() ? 0 : segments_.front().readerIndex;
+        }
+        return readerIndex_;
+    }
 
     // 返回可读数据的起始地址
-    const char* peek() const { return begin() + readerIndex_; }
+    // 分段模式下会先把所有可读数据合并到一个块中, 保证 [peek(), peek()+readableBytes()) 连续
+    const char* peek() const
+    {
+        if (segmented())
+        {
+            return segmentedPeek();
+        }
+        return begin() + readerIndex_;
+    }
     // 返回可写区域的起始地址
-    char* beginWrite() { return begin() + writerIndex_; }
-    const char* beginWrite() const { return begin() + writerIndex_; }
+    char* beginWrite()
+    {
+        if (segmented())
+        {
+            return segments_.empty() ? nullptr : segments_.back().beginWrite();
+        }
+        return begin() + writerIndex_;
+    }
+    const char* beginWrite() const
+    {
+        if (segmented())
+        {
+            return segments_.empty() ? nullptr : segments_.back().beginWrite();
+        }
+        return begin() + writerIndex_;
+    }
 
     // 从缓冲区读了len字节的数据
     void retrieve(size_t len)
     {
         if (len < readableBytes())  // 只读取了一部分可读数据
         {
-            readerIndex_ += len;
+            if (segmented())
+            {
+                segmentedRetrieve(len);
+            }
+            else
+            {
+                readerIndex_ += len;
+            }
         }
         else  // 所有可读数据都被读取了
         {
@@ -50,17 +123,19 @@ class Buffer
         }
     }
     // 读完缓冲区所有数据,并执行复位操作
-    void retrieveAll() { readerIndex_ = writerIndex_ = kCheapPrepend; }
+    void retrieveAll()
+    {
+        if (segmented())
+        {
+            releaseSegments();  // 分段模式下已读完的块直接归还
+        }
+        readerIndex_ = writerIndex_ = kCheapPrepend;
+    }
     // 从缓冲区读取len字节的数据,并作为字符串返回
     std::string retrieveAllAsString() { return retrieveAsString(readableBytes()); }
     // 从缓冲区读取len字节的数据,作为字符串返回,并执行复位操作
-    std::string retrieveAsString(size_t len)
-    {
-        std::string result(peek(), len);
-        retrieve(len);
-        return result;
-    }
-    // 确保缓冲区至少有len字节的可写空间
+    std::string retrieveAsString(size_t len);
+    // 确保缓冲区至少有len字节的连续可写空间
     void ensureWriteableBytes(size_t len)
     {
         if (writableBytes() < len)
@@ -71,6 +146,11 @@ class Buffer
     // 向缓冲区写入len字节的数据
     void append(const char* data, size_t len)
     {
+        if (segmented())
+        {
+            segmentedAppend(data, len);
+            return;
+        }
         // 1. 确保空间
         ensureWriteableBytes(len);
         // 2. 拷贝数据
@@ -78,26 +158,49 @@ class Buffer
         // 3. 更新写索引
         writerIndex_ += len;
     }
+    // 返回当前占用的存储区总大小(未分配时为0)
+    size_t capacity() const;
+    // 收缩存储区: 没有可读数据且 reserve 为0时把存储区整块归还内存池,
+    // 否则缩小到刚好容纳可读数据 + reserve 字节
+    void shrink(size_t reserve = 0);
+
     // 从指定fd中读取数据
     ssize_t readFd(int fd, int* saveErrno);
     // 向指定fd中写入数据
     ssize_t writeFd(int fd, int* saveErrno);
 
    private:
-    // 返回底层 vector 存储区的起始地址
-    char* begin()
+    // 分段模式下的一个数据块
+    struct Segment
     {
-        return &*buffer_.begin();  // vector底层数组首元素的地址，也就是数组的起始地址
-    }
-    const char* begin() const { return &*buffer_.begin(); }
+        char* data;          // 块的起始地址
+        size_t capacity;     // 块的总大小
+        size_t readerIndex;  // 块内读索引
+        size_t writerIndex;  // 块内写索引
+
+        size_t readableBytes() const { return writerIndex - readerIndex; }
+        size_t writableBytes() const { return capacity - writerIndex; }
+        const char* peek() const { return data + readerIndex; }
+        char* beginWrite() const { return data + writerIndex; }
+    };
+
+    // 返回底层存储区的起始地址
+    char* begin() { return buffer_; }
+    const char* begin() const { return buffer_; }
 
     // 扩容
     void makeSpace(size_t len)
     {
+        if (segmented())
+        {
+            // 分段模式: 直接挂上一个足够大的新块, 已有数据原地不动
+            pushSegment(std::max(len, kSegmentSize));
+            return;
+        }
         // 策略二：移动数据(空间复用)
         if (writableBytes() + prependableBytes() < len + kCheapPrepend)
         {
-            buffer_.resize(writerIndex_ + len);
+            grow(kCheapPrepend + readableBytes() + len);
         }
         // 策略一：扩容(内存重新分配)
         else
@@ -111,7 +214,31 @@ class Buffer
         }
     }
 
-    std::vector<char> buffer_;  // 缓冲区
-    size_t readerIndex_;        // 读索引，应用程序从这里开始读取数据
-    size_t writerIndex_;        // 写索引，新数据从这里开始写入
-};
\ No newline at end of file
+    // 连续模式下从内存池重新分配至少 capacity 字节的存储区, 只搬移可读数据
+    void grow(size_t capacity);
+
+    // 归还连续模式的存储区, 回到未分配状态
+    void releaseStorage();
+
+    // 分段模式的具体实现
+    const char* segmentedPeek() const;
+    void segmentedRetrieve(size_t len);
+    void segmentedAppend(const char* data, size_t len);
+    ssize_t segmentedReadFd(int fd, int* saveErrno);
+    ssize_t segmentedWriteFd(int fd, int* saveErrno);
+    // 在链表尾部挂上一个容量为capacity的新块
+    Segment& pushSegment(size_t capacity);
+    // 归还所有数据块
+    void releaseSegments();
+
+    Mode mode_;           // 存储模式
+    char* buffer_;        // 缓冲区(连续模式), 存储区来自当前线程 EventLoop 的 BufferPool
+    size_t capacity_;     // 缓冲区总大小(连续模式)
+    size_t initialSize_;  // 首次分配时的最小可用大小(连续模式)
+    size_t readerIndex_;  // 读索引，应用程序从这里开始读取数据
+    size_t writerIndex_;  // 写索引，新数据从这里开始写入
+
+    // peek() 需要在 const 语义下合并数据块, 因此声明为 mutable
+    mutable std::deque<Segment> segments_;  // 数据块链表(分段模式)
+    size_t segmentedReadable_;              // 所有数据块中可读数据的总长度(分段模式)
+};
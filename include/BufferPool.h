@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "noncopyable.h"
+
+/**
+ * BufferPool 是每个 EventLoop 独占的内存块池, 为 Buffer 提供存储区
+ * - 按 2 的幂划分大小等级(1KB ~ 64KB), 每个等级维护一条侵入式空闲链表
+ * - 只被所属 loop 线程访问(通过线程局部指针定位), 全程无锁
+ * - 超过最大等级的请求直接走 malloc/free
+ * - 空闲块总量超过上限时, 归还的块直接 free, 避免池无限膨胀
+ *
+ * 池中的块和 malloc 得到的内存可以互换: 一个块可以在 A 线程分配、在 B 线程归还,
+ * 此时它进入 B 线程的池(或在没有池的线程中直接 free)
+ */
+class BufferPool : noncopyable
+{
+   public:
+    static const size_t kMinBlockSize = 1024;       // 最小等级 1KB
+    static const size_t kMaxBlockSize = 64 * 1024;  // 最大等级 64KB
+    static const int kNumClasses = 7;               // 1K 2K 4K 8K 16K 32K 64K
+    static const size_t kDefaultMaxBytesHeld = 16 * 1024 * 1024;  // 默认最多缓存16MB空闲块
+
+    // 统计信息快照, 可以在任意线程读取
+    struct Stats
+    {
+        uint64_t hits;       // 从空闲链表直接取到块的次数
+        uint64_t misses;     // 空闲链表为空, 回落到 malloc 的次数(含超大块)
+        uint64_t releases;   // 归还块的次数
+        size_t bytesHeld;    // 当前缓存的空闲块总字节数
+        size_t blocksHeld;   // 当前缓存的空闲块数量
+    };
+
+    BufferPool();
+    ~BufferPool();
+
+    // 分配/归还一个块, capacity 必须是 roundUp() 的返回值
+    char* allocate(size_t capacity);
+    void deallocate(char* block, size_t capacity);
+
+    // 设置空闲块的缓存上限
+    void setMaxBytesHeld(size_t bytes) { maxBytesHeld_ = bytes; }
+    // 获取统计信息
+    Stats stats() const;
+
+    // 把 size 向上取整到所属的大小等级(超过最大等级时原样返回)
+    static size_t roundUp(size_t size);
+
+    // 当前线程的池(由 EventLoop 在构造/析构时设置), 非 loop 线程返回 nullptr
+    static BufferPool* current();
+    static void setCurrent(BufferPool* pool);
+
+    // Buffer 使用的分配入口: 有池走池, 没有池直接 malloc/free
+    static char* allocateBlock(size_t capacity);
+    static void deallocateBlock(char* block, size_t capacity);
+
+   private:
+    // 空闲链表节点, 直接复用空闲块自身的内存
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+
+    // 返回 capacity 对应的等级下标, 超过最大等级返回 -1
+    static int classIndex(size_t capacity);
+
+    // 计数器只由所属线程写入, 其他线程只读快照, 因此用 relaxed 原子量即可
+    static void increase(std::atomic<uint64_t>& counter)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    FreeBlock* freeLists_[kNumClasses];  // 每个等级的空闲链表
+    size_t maxBytesHeld_;                // 空闲块缓存上限
+
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+    std::atomic<uint64_t> releases_;
+    std::atomic<size_t> bytesHeld_;
+    std::atomic<size_t> blocksHeld_;
+};
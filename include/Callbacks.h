@@ -8,6 +8,7 @@ class TcpConnection;
 class Timestamp;
 
 using TcpConnectionPtr = std::shared_ptr<TcpConnection>;  // 定义TcpConnection类型的智能指针
+using TimerCallback = std::function<void()>;              // 定时器到期时，调用相应的回调
 using ConnectionCallback =
     std::function<void(const TcpConnectionPtr&)>;  // 当有新连接建立或连接断开时，调用相应的回调
 using CloseCallback = std::function<void(const TcpConnectionPtr&)>;  // 当连接断开时，调用相应的回调
@@ -16,4 +17,8 @@ using WriteCompleteCallback =
 using MessageCallback = std::function<void(
     const TcpConnectionPtr&, Buffer*, Timestamp)>;  // 当已连接的客户端有数据可读时，调用相应的回调
 using HighWaterMarkCallback = std::function<void(
-    const TcpConnectionPtr&, size_t)>;  // 当发送缓冲区超过设定值时，调用相应的回调
\ No newline at end of file
+    const TcpConnectionPtr&, size_t)>;  // 当发送缓冲区超过设定值时，调用相应的回调
+using LowWaterMarkCallback = std::function<void(
+    const TcpConnectionPtr&, size_t)>;  // 发送缓冲区从高水位回落到低水位以下时，调用相应的回调
+using MigrateCallback = std::function<void(
+    const TcpConnectionPtr&, bool)>;  // 连接迁移结束时，调用相应的回调(参数表示是否迁移成功)
\ No newline at end of file
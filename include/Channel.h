@@ -2,6 +2,7 @@
 
 #include <functional>
 #include <memory>
+#include "InplaceFunction.h"
 #include "noncopyable.h"
 #include "Timestamp.h"
 
@@ -15,10 +16,12 @@ class EventLoop;
 class Channel : noncopyable
 {
 public:
-    // 读写事件回调函数
-    using EventCallback = std::function<void()>;
+    // 读写事件回调函数(只能移动, 绑定的对象较小时不分配堆内存)
+    using EventCallback = InplaceFunction<void()>;
     // 只读事件回调函数
-    using ReadEventCallback = std::function<void(Timestamp)>;
+    using ReadEventCallback = InplaceFunction<void(Timestamp)>;
+    // 错误队列回调函数, 返回 true 表示本次 EPOLLERR 仅由错误队列中的通知引起(如零拷贝完成通知)
+    using ErrorQueueCallback = InplaceFunction<bool()>;
 
     Channel(EventLoop *loop, int fd);
     ~Channel();
@@ -31,14 +34,25 @@ public:
     void setWriteCallback(EventCallback cb) { writeCallback_ = std::move(cb); }
     void setCloseCallback(EventCallback cb) { closeCallback_ = std::move(cb); }
     void setErrorCallback(EventCallback cb) { errorCallback_ = std::move(cb); }
+    void setErrorQueueCallback(ErrorQueueCallback cb) { errorQueueCallback_ = std::move(cb); }
 
     // 绑定一个共享指针对象，确保Channel对象在手动移除后不会继续执行回调
     void tie(const std::shared_ptr<void> &);
 
     // 获取fd
     int fd() const { return fd_; }
-    // 设置fd的监听事件
-    int events() const { return events_; }
+    // 返回需要注册到Poller的事件
+    // 边缘触发模式下可写事件在注册后一直保持关注, 由 isWriting() 记录上层是否真的需要它
+    int events() const
+    {
+        return edgeTriggered_ && events_ != kNoneEvent ? (events_ | kWriteEvent | kEdgeTriggered)
+                                                       : events_;
+    }
+
+    // 设置边缘触发模式(EPOLLET), 只能在注册到Poller之前调用
+    // 开启后 enableWriting/disableWriting 只修改逻辑状态, 不再触发 epoll_ctl
+    void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+    bool edgeTriggered() const { return edgeTriggered_; }
     // 设置已发生的事件集合
     void set_revents(int revt) { revents_ = revt; }
 
@@ -55,13 +69,15 @@ public:
     }
     void enableWriting()
     {
+        int registered = events();
         events_ |= kWriteEvent;
-        update();
+        updateIfChanged(registered);
     }
     void disableWriting()
     {
+        int registered = events();
         events_ &= ~kWriteEvent;
-        update();
+        updateIfChanged(registered);
     }
     void disableAll()
     {
@@ -74,20 +90,25 @@ public:
     bool isWriting() const { return events_ & kWriteEvent; }
     bool isReading() const { return events_ & kReadEvent; }
 
-    // 获取索引值
-    int index() { return index_; }
-    // 设置索引值
-    void set_index(int idx) { index_ = idx; }
-
     // one loop per thread
     // 获取所属的EventLoop对象
     EventLoop *ownerLoop() { return loop_; }
     // 从EventLoop中移除当前Channel对象
     void remove();
+    // 改为由另一个EventLoop管理(连接迁移), 调用前必须已经 remove()
+    void setOwnerLoop(EventLoop *loop) { loop_ = loop; }
 
 private:
     // 更新事件监听状态
     void update();
+    // 水平触发模式下总是更新; 边缘触发模式下只有注册的事件变化时才更新
+    void updateIfChanged(int registeredEvents)
+    {
+        if (!edgeTriggered_ || events() != registeredEvents)
+        {
+            update();
+        }
+    }
     /**
      * 实际的事件分发逻辑
      * 对每种事件，必须先判断对应的回调函数对象是否有效（非空），然后再调用它。
@@ -99,12 +120,13 @@ private:
     int fd_;          // Poller监听的对象
     int events_;      // 注册fd感兴趣的事件
     int revents_;     // Poller实际返回的具体事件
-    int index_;       // 供Poller使用，标记Channel在Poller中的状态
+    bool edgeTriggered_; // 是否使用边缘触发模式
 
     // 表示不同的事件类型
     static const int kNoneEvent;  // 无事件
     static const int kReadEvent;  // 读事件
     static const int kWriteEvent; // 写事件
+    static const int kEdgeTriggered; // 边缘触发标志
 
     std::weak_ptr<void> tie_; // 弱指针，用于“绑定”上层对象
     bool tied_;               // 标记channel是否绑定了上层对象
@@ -114,4 +136,5 @@ private:
     EventCallback writeCallback_;    // 写事件
     EventCallback closeCallback_;    // 关闭事件
     EventCallback errorCallback_;    // 错误事件
+    ErrorQueueCallback errorQueueCallback_; // 错误队列通知(EPOLLERR时优先处理)
 };
\ No newline at end of file
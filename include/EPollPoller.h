@@ -32,7 +32,7 @@ private:
     // 填写活跃的连接
     void fillActiveChannels(int numEvents, ChannelList *activeChannels) const;
     // 更新channel通道
-    void update(int operation, Channel *channel);
+    void update(int operation, Channel *channel, uint32_t generation);
 
 private:
     static const int kInitEventListSize = 16; // events_ 数组的初始长度
@@ -3,22 +3,29 @@
 #include <atomic>
 #include <functional>
 #include <memory>
-#include <mutex>
 #include <unistd.h>
 #include <vector>
 
+#include "BufferPool.h"
+#include "Callbacks.h"
 #include "CurrentThread.h"
+#include "EventLoopMetrics.h"
+#include "InplaceFunction.h"
+#include "TimerId.h"
 #include "Timestamp.h"
 #include "noncopyable.h"
 
 class Channel;
 class Poller;
 class TimerQueue;
+class TimingWheel;
 // 事件循环类，主要包含两大模块 Channel 和 Poller(epoll的抽象)
 class EventLoop : noncopyable
 {
    public:
-    using Functor = std::function<void()>;  // 用于存储需要在 EventLoop 线程中执行的回调函数
+    // 用于存储需要在 EventLoop 线程中执行的回调函数
+    // 只能移动; 绑定一个 shared_ptr 和少量参数的回调直接保存在对象内部, 投递时不分配堆内存
+    using Functor = InplaceFunction<void()>;
 
     EventLoop();
     ~EventLoop();
@@ -34,6 +41,30 @@ class EventLoop : noncopyable
     void runInLoop(Functor cb);
     // 把cb放入队列，唤醒loop所在的线程，执行cb
     void queueInLoop(Functor cb);
+    // 把cb放入本轮循环的收尾队列: 在本轮所有事件和回调处理完之后执行(只能在loop线程中调用)
+    // 用于把一轮循环内的多次写操作合并为一次系统调用
+    void queueFlush(Functor cb);
+    // 把cb放入下一次收尾队列, 不唤醒loop(只能在loop线程中调用): 收尾阶段之前登记的在本轮末尾执行,
+    // 收尾阶段中登记的推迟到下一轮循环末尾, 因此可在回调中重新登记, 实现每轮循环检查一次
+    void queueNextFlush(Functor cb);
+
+    // 定时器, 可以在任意线程调用, 回调总是在loop线程中执行
+    // 在 time 时刻执行cb
+    TimerId runAt(Timestamp time, TimerCallback cb);
+    // 在 delay 秒后执行cb
+    TimerId runAfter(double delay, TimerCallback cb);
+    // 每隔 interval 秒执行一次cb
+    TimerId runEvery(double interval, TimerCallback cb);
+    // 取消定时器
+    void cancel(TimerId timerId);
+    // 本loop的时间轮(首次调用时创建), 用于大量连接级别的超时, 只能在loop线程中使用
+    TimingWheel* timingWheel();
+
+    // 开启自适应忙轮询(只能在loop线程中调用, 如 EventLoopThread 的线程初始化回调): 阻塞在 poll 之前,
+    // 先以 0 超时反复 poll 最多 maxSpinUs 微秒; 实际自旋时长随最近的流量自适应调整:
+    // 阻塞后很快就被唤醒说明自旋再久一点就能接住事件, 时长加倍; 长时间空闲则减半。0 表示关闭(默认)
+    // 以CPU换取更低的唤醒延迟, 适合对延迟极其敏感的loop
+    void setBusyPoll(int maxSpinUs);
 
     // 唤醒loop所在线程
     void wakeup();
@@ -42,15 +73,30 @@ class EventLoop : noncopyable
     void updateChannel(Channel* channel);
     void removeChannel(Channel* channel);
     bool hasChannel(Channel* channel);
+    // 当前Poller是否支持边缘触发模式的 Channel
+    bool supportsEdgeTriggered() const;
 
     // 判断当前loop对象是否在自己的线程中
     bool isInLoopThread() const { return threadId_ == CurrentThread::tid(); }
 
+    // 获取本loop的Buffer内存池(统计信息可以在任意线程读取)
+    BufferPool& bufferPool() { return bufferPool_; }
+    const BufferPool& bufferPool() const { return bufferPool_; }
+
+    // 本loop的运行统计: poll 阻塞时间、每次唤醒的事件数、回调耗时、跨线程回调的排队情况等
+    // metrics().snapshot() 可以在任意线程调用; metrics().setEnabled(false) 关闭计时
+    EventLoopMetrics& metrics() { return metrics_; }
+    const EventLoopMetrics& metrics() const { return metrics_; }
+
    private:
     // 处理wakeup()
     void handleRead();
     // 执行回调
-    void doPendingFunctors();
+    void doPendingFunctors(bool timing);
+    // 执行本轮循环的收尾回调
+    void doFlushFunctors();
+    // 忙轮询模式下的 poll: 先自旋, 没有事件再阻塞
+    Timestamp busyPoll(int timeoutMs);
 
    private:
     using ChannelList = std::vector<Channel*>;  // 用于存储 Poller 返回的活跃 Channel
@@ -61,15 +107,42 @@ class EventLoop : noncopyable
     const pid_t threadId_;  // 记录当前loop所在线程的id
 
     Timestamp pollReturnTime_;  // poller返回发生事件的channels的返回时间点
+    int busyPollMaxUs_;         // 忙轮询的最长自旋时间(微秒), 0 表示关闭
+    int busyPollBudgetUs_;      // 当前自适应的自旋时间(微秒)
+    BufferPool bufferPool_;     // 本loop线程独占的Buffer内存池, 需先于其他成员构造、后于其析构
     std::unique_ptr<Poller> poller_;
 
     int wakeupFd_;                            // 用于跨线程通知 wakeupLoop 的fd
     std::unique_ptr<Channel> wakeupChannel_;  // 封装wakeupFd_的channel对象
+    std::unique_ptr<TimerQueue> timerQueue_;  // 本loop的定时器队列, 依赖 poller_, 需在其后构造
+    std::unique_ptr<TimingWheel> timingWheel_;  // 本loop的时间轮, 由 timerQueue_ 驱动, 需先于其析构
 
     ChannelList activeChannels_;  // 存储poller返回的当前有事件发生的channel列表
     // Channel* currentActiveChannel_;  // 指向当前正在处理事件的channel
 
+    // 跨线程投递的回调节点, 组成无锁的单向链表(栈)
+    struct PendingFunctor
+    {
+        Functor cb;
+        PendingFunctor* next;
+        uint64_t enqueueNs;  // 投递时间, 未开启计时时为 0; 空闲链表的头节点用它记录链表长度
+    };
+    // 每个投递线程私有的空闲节点缓存, 定义在 EventLoop.cpp 中
+    struct FunctorCache;
+    PendingFunctor* allocFunctor();
+    void recycleFunctors(PendingFunctor* head, PendingFunctor* tail, uint64_t count);
+
     std::atomic_bool callingPendingFunctors_;  // 标志当前loop是否有需要执行的回调操作
-    std::vector<Functor> pendingFunctors_;     // 存储loop需要执行的所有回调操作
-    std::mutex mutex_;  // 互斥锁,用来保护上面vector容器的线程安全操作
+    // 存储loop需要执行的所有回调操作: 多个生产者用 CAS 压栈, loop线程一次性取走整条链表
+    std::atomic<PendingFunctor*> pendingFunctors_;
+    // 执行完毕的节点归还到这里: 只有loop线程放回, 投递线程每次整条取走, 因此没有 ABA 问题
+    std::atomic<PendingFunctor*> freeFunctors_;
+    // 已经写过 wakeupFd_ 且 loop 尚未读走, 此期间的投递不再重复写 eventfd
+    std::atomic_bool wakeupPending_;
+
+    std::vector<Functor> flushFunctors_;  // 本轮循环的收尾回调(只在loop线程中访问)
+    std::vector<Functor> flushScratch_;   // 执行收尾回调时使用的临时容器, 复用其容量
+    std::vector<Functor> nextFlushFunctors_;  // 推迟到下一次收尾阶段的回调(只在loop线程中访问)
+
+    EventLoopMetrics metrics_;  // 运行统计, 只由loop线程写入(pendingDepth 除外)
 };
\ No newline at end of file
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+#include <time.h>
+
+#include "noncopyable.h"
+
+/**
+ * Log2Histogram 是按 2 的幂分桶的直方图, 用于记录耗时(纳秒)和批量大小
+ * - 第 0 个桶记录 0, 第 i 个桶记录 [2^(i-1), 2^i), 最后一个桶兼收更大的值
+ * - 只由一个线程写入, 其他线程可以随时读取快照, 因此全部使用 relaxed 原子量
+ */
+class Log2Histogram : noncopyable
+{
+   public:
+    static const int kNumBuckets = 40;  // 纳秒计时时最后一个桶从约 275 秒开始
+
+    // 直方图快照
+    struct Snapshot
+    {
+        uint64_t count;  // 样本数
+        uint64_t sum;    // 样本之和
+        uint64_t max;    // 最大样本
+        uint64_t buckets[kNumBuckets];
+
+        double mean() const { return count ? static_cast<double>(sum) / count : 0.0; }
+        // 估算第 p(0~1) 分位数: 返回样本所在桶的上界(不超过最大样本)
+        uint64_t percentile(double p) const;
+    };
+
+    Log2Histogram();
+
+    void record(uint64_t value)
+    {
+        int idx = value == 0 ? 0 : 64 - __builtin_clzll(value);
+        if (idx >= kNumBuckets)
+        {
+            idx = kNumBuckets - 1;
+        }
+        increase(buckets_[idx], 1);
+        increase(count_, 1);
+        increase(sum_, value);
+        if (value > max_.load(std::memory_order_relaxed))
+        {
+            max_.store(value, std::memory_order_relaxed);
+        }
+    }
+
+    Snapshot snapshot() const;
+    uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+
+   private:
+    static void increase(std::atomic<uint64_t>& counter, uint64_t delta)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> max_;
+    std::atomic<uint64_t> buckets_[kNumBuckets];
+};
+
+/**
+ * EventLoopMetrics 记录一个 EventLoop 的时间都花在了哪里, 用于区分:
+ * loop 本身已经饱和、某个用户回调很慢, 还是跨线程投递的回调在排队
+ * - 由 loop 线程在 EventLoop::loop() 中写入, 任意线程都可以通过 snapshot() 读取
+ * - 耗时使用 CLOCK_MONOTONIC(vDSO, 不陷入内核), 单位纳秒
+ * - 可以在运行时关闭, 关闭后 loop 不再读取时钟, 只保留 pendingDepth 等计数
+ */
+class EventLoopMetrics : noncopyable
+{
+   public:
+    // 统计信息快照, 可以在任意线程读取; 两次快照相减即为这段时间内的增量
+    struct Snapshot
+    {
+        uint64_t iterations;    // loop 循环的轮数
+        uint64_t busyNs;        // 处理事件、回调和收尾回调的总耗时
+        uint64_t pendingDepth;  // 当前已投递、尚未执行的回调数(最大值见 pendingBatch.max)
+        int64_t connections;    // 当前绑定到本loop的已建立连接数(由 TcpConnection 维护)
+
+        Log2Histogram::Snapshot pollNs;           // 每次阻塞(含忙轮询的自旋)在 poll 中的时间
+        Log2Histogram::Snapshot eventsPerWakeup;  // 每次 poll 返回的活跃 Channel 数
+        Log2Histogram::Snapshot handlerNs;        // 每次 Channel::handleEvent 的耗时
+        Log2Histogram::Snapshot pendingBatch;     // 每次 doPendingFunctors 执行的回调数
+        Log2Histogram::Snapshot pendingNs;        // 每次 doPendingFunctors 的耗时
+        Log2Histogram::Snapshot queueDelayNs;     // 每批中最早的回调从投递到开始执行的等待时间
+
+        // loop 忙碌时间占比(0~1), 接近 1 说明 loop 已经饱和
+        double utilization() const;
+        // 单行的可读摘要, 便于写日志
+        std::string toString() const;
+    };
+
+    EventLoopMetrics();
+
+    // 开启/关闭耗时统计(默认开启), 可以在任意线程调用
+    void setEnabled(bool on) { enabled_.store(on, std::memory_order_relaxed); }
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    Snapshot snapshot() const;
+
+    // 单项读取, 比 snapshot() 便宜, 供 EventLoopThreadPool 的负载均衡策略使用
+    uint64_t busyNs() const { return busyNs_.load(std::memory_order_relaxed); }
+    uint64_t pollNs() const { return pollNs_.sum(); }
+    uint64_t pendingDepth() const { return pendingDepth_.load(std::memory_order_relaxed); }
+    int64_t connections() const { return connections_.load(std::memory_order_relaxed); }
+
+    // 调整连接数: TcpConnection 在 connectEstablished/connectDestroyed 中(所属loop线程)加一/减一,
+    // 迁移时由原loop线程把计数转移到新的loop, 因此需要原子的加减
+    void addConnections(int64_t delta) { connections_.fetch_add(delta, std::memory_order_relaxed); }
+
+    // 单调时钟, 单位纳秒
+    static uint64_t nowNs()
+    {
+        struct timespec ts;
+        ::clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+
+   private:
+    friend class EventLoop;
+
+    static void increase(std::atomic<uint64_t>& counter, uint64_t delta)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+    // 由投递回调的线程在回调入队之前调用, 可能有多个线程同时调用
+    void addPending() { pendingDepth_.fetch_add(1, std::memory_order_relaxed); }
+    void removePending(uint64_t n) { pendingDepth_.fetch_sub(n, std::memory_order_relaxed); }
+
+    std::atomic<bool> enabled_;
+    std::atomic<uint64_t> iterations_;
+    std::atomic<uint64_t> busyNs_;
+    std::atomic<uint64_t> pendingDepth_;
+    std::atomic<int64_t> connections_;
+
+    Log2Histogram pollNs_;
+    Log2Histogram eventsPerWakeup_;
+    Log2Histogram handlerNs_;
+    Log2Histogram pendingBatch_;
+    Log2Histogram pendingNs_;
+    Log2Histogram queueDelayNs_;
+};
\ No newline at end of file
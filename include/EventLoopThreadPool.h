@@ -2,6 +2,7 @@
 
 #include <functional>
 #include <memory>
+#include <stdint.h>
 #include <string>
 #include <vector>
 
@@ -9,12 +10,25 @@
 
 class EventLoop;
 class EventLoopThread;
+class InetAddress;
 
 class EventLoopThreadPool : noncopyable
 {
    public:
     // 线程初始化回调函数类型
     using ThreadInitCallback = std::function<void(EventLoop*)>;
+    // 自定义的 loop 选择函数: 从 loops 中为来自 peerAddr 的新连接选择一个
+    using LoopSelector =
+        std::function<EventLoop*(const std::vector<EventLoop*>& loops, const InetAddress& peerAddr)>;
+
+    // 为新连接选择 Sub Loop 的策略
+    enum LoadBalance
+    {
+        kRoundRobin,         // 轮询(默认)
+        kLeastConnections,   // 选择当前连接数最少的 loop
+        kPowerOfTwoChoices,  // 随机取两个 loop, 选择实时负载较低的一个
+        kHashByPeer,         // 按对端 IP 哈希, 同一客户端的连接总是落在同一个 loop
+    };
 
     EventLoopThreadPool(EventLoop* baseLoop, const std::string& nameArg);
     ~EventLoopThreadPool();
@@ -23,16 +37,42 @@ class EventLoopThreadPool : noncopyable
     void setThreadNum(int numThreads) { threadNum_ = numThreads; }
     // 启动线程池
     void start(const ThreadInitCallback& cb = ThreadInitCallback());
-    // 获取下一个 EventLoop
+    // 设置选择策略 / 自定义选择函数(设置后优先于策略), 只能在 start() 之前调用
+    void setLoadBalance(LoadBalance strategy) { strategy_ = strategy; }
+    void setLoopSelector(const LoopSelector& selector) { selector_ = selector; }
+
+    // 获取下一个 EventLoop(轮询)
     EventLoop* getNextLoop();
+    // 按选择策略为来自 peerAddr 的新连接获取一个 EventLoop
+    EventLoop* getNextLoop(const InetAddress& peerAddr);
+    // 按哈希值获取 EventLoop, 同一个哈希值总是得到同一个 loop
+    EventLoop* getLoopForHash(size_t hashCode);
     // 获取线程池中所有的 EventLoop 指针
     std::vector<EventLoop*> getAllLoops();
+    // 各个 Sub Loop 最近的忙碌占比(0~1), 顺序与 getAllLoops() 一致, 没有 Sub Loop 时为空
+    std::vector<double> getRecentUtilizations();
     // 检查线程池是否已启动
     bool started() const { return started_; }
     // 获取线程池名称
     const std::string& name() const { return name_; }
 
    private:
+    // 一个 loop 最近一段时间的负载, 用于 kPowerOfTwoChoices
+    struct LoopLoad
+    {
+        uint64_t busyNs;     // 上次刷新时的累计忙碌时间
+        uint64_t pollNs;     // 上次刷新时的累计 poll 时间
+        double utilization;  // 最近一个刷新周期内的忙碌占比
+    };
+    static const uint64_t kLoadRefreshNs = 100 * 1000 * 1000;  // 负载的刷新周期 100ms
+
+    EventLoop* getLeastConnectionsLoop();
+    EventLoop* getPowerOfTwoChoicesLoop();
+    // 刷新各个 loop 最近的忙碌占比
+    void refreshLoads();
+    // a 的负载是否低于 b
+    bool lessLoaded(size_t a, size_t b) const;
+
     EventLoop* baseLoop_;  // 用户创建的主EventLoop
     std::string name_;     // 线程池名称
     bool started_;         // 线程池是否已启动
@@ -41,4 +81,10 @@ class EventLoopThreadPool : noncopyable
     std::vector<std::unique_ptr<EventLoopThread>>
         threads_;                    // 存储 EventLoopThread 对象的智能指针数组
     std::vector<EventLoop*> loops_;  // 存储线程池中所有 EventLoop 的指针
+
+    LoadBalance strategy_;         // 选择策略
+    LoopSelector selector_;        // 自定义选择函数
+    std::vector<LoopLoad> loads_;  // 与 loops_ 一一对应
+    uint64_t lastRefreshNs_;       // 上次刷新负载的时间
+    uint64_t randomState_;         // kPowerOfTwoChoices 使用的随机数状态(xorshift)
 };
\ No newline at end of file
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+template <typename Signature, size_t Capacity = 64>
+class InplaceFunction;
+
+/**
+ * InplaceFunction 是只能移动的可调用对象包装器, 用来代替 std::function 保存内部回调
+ * - 自带 Capacity 字节的内联存储, 不超过该大小且移动构造不抛异常的可调用对象直接原地构造, 不分配堆内存
+ *   (如 std::bind(&TcpConnection::xxx, shared_from_this(), ...) 以及捕获少量变量的 lambda)
+ * - 放不下的可调用对象回退到堆上保存, 行为与 std::function 相同
+ * - 只能移动、不能拷贝, 因此也可以保存只能移动的可调用对象
+ * - 调用空对象会抛出 std::bad_function_call
+ */
+template <typename R, typename... Args, size_t Capacity>
+class InplaceFunction<R(Args...), Capacity>
+{
+   public:
+    InplaceFunction() noexcept : ops_(nullptr) {}
+    InplaceFunction(std::nullptr_t) noexcept : ops_(nullptr) {}
+
+    template <typename F, typename = typename std::enable_if<!std::is_same<
+                              typename std::decay<F>::type, InplaceFunction>::value>::type>
+    InplaceFunction(F&& f) : ops_(nullptr)
+    {
+        using Fn = typename std::decay<F>::type;
+        if (isNull(f))
+        {
+            return;
+        }
+        construct<Fn>(std::forward<F>(f), std::integral_constant<bool, fitsInline<Fn>()>());
+    }
+
+    InplaceFunction(InplaceFunction&& rhs) noexcept : ops_(nullptr) { moveFrom(rhs); }
+
+    InplaceFunction& operator=(InplaceFunction&& rhs) noexcept
+    {
+        if (this != &rhs)
+        {
+            reset();
+            moveFrom(rhs);
+        }
+        return *this;
+    }
+
+    InplaceFunction& operator=(std::nullptr_t) noexcept
+    {
+        reset();
+        return *this;
+    }
+
+    InplaceFunction(const InplaceFunction&) = delete;
+    InplaceFunction& operator=(const InplaceFunction&) = delete;
+
+    ~InplaceFunction() { reset(); }
+
+    R operator()(Args... args) const
+    {
+        if (ops_ == nullptr)
+        {
+            throw std::bad_function_call();
+        }
+        return ops_->invoke(const_cast<void*>(static_cast<const void*>(&storage_)),
+                            std::forward<Args>(args)...);
+    }
+
+    explicit operator bool() const noexcept { return ops_ != nullptr; }
+
+   private:
+    // 每种被包装的类型对应一张操作表
+    struct Ops
+    {
+        R (*invoke)(void* storage, Args&&... args);
+        void (*relocate)(void* dst, void* src);  // 移动到 dst 并销毁 src
+        void (*destroy)(void* storage);
+    };
+
+    using Storage = typename std::aligned_storage<Capacity, alignof(std::max_align_t)>::type;
+
+    template <typename Fn>
+    static constexpr bool fitsInline()
+    {
+        return sizeof(Fn) <= Capacity && alignof(Fn) <= alignof(std::max_align_t) &&
+               std::is_nothrow_move_constructible<Fn>::value;
+    }
+
+    // 可调用对象直接保存在内联存储中
+    template <typename Fn>
+    struct InlineHandler
+    {
+        static Fn* get(void* storage) { return static_cast<Fn*>(storage); }
+        static R invoke(void* storage, Args&&... args)
+        {
+            return (*get(storage))(std::forward<Args>(args)...);
+        }
+        static void relocate(void* dst, void* src)
+        {
+            ::new (dst) Fn(std::move(*get(src)));
+            get(src)->~Fn();
+        }
+        static void destroy(void* storage) { get(storage)->~Fn(); }
+        static const Ops* ops()
+        {
+            static const Ops table = {&invoke, &relocate, &destroy};
+            return &table;
+        }
+    };
+
+    // 内联存储中只保存指向堆上可调用对象的指针
+    template <typename Fn>
+    struct HeapHandler
+    {
+        static Fn* get(void* storage) { return *static_cast<Fn**>(storage); }
+        static R invoke(void* storage, Args&&... args)
+        {
+            return (*get(storage))(std::forward<Args>(args)...);
+        }
+        static void relocate(void* dst, void* src) { ::new (dst) Fn*(get(src)); }
+        static void destroy(void* storage) { delete get(storage); }
+        static const Ops* ops()
+        {
+            static const Ops table = {&invoke, &relocate, &destroy};
+            return &table;
+        }
+    };
+
+    template <typename Fn, typename F>
+    void construct(F&& f, std::true_type)
+    {
+        ::new (static_cast<void*>(&storage_)) Fn(std::forward<F>(f));
+        ops_ = InlineHandler<Fn>::ops();
+    }
+
+    template <typename Fn, typename F>
+    void construct(F&& f, std::false_type)
+    {
+        ::new (static_cast<void*>(&storage_)) Fn*(new Fn(std::forward<F>(f)));
+        ops_ = HeapHandler<Fn>::ops();
+    }
+
+    // 空的函数指针和 std::function 包装后仍然为空
+    template <typename T>
+    static bool isNull(const T&)
+    {
+        return false;
+    }
+    template <typename T>
+    static bool isNull(T* p)
+    {
+        return p == nullptr;
+    }
+    template <typename S>
+    static bool isNull(const std::function<S>& f)
+    {
+        return !f;
+    }
+
+    void moveFrom(InplaceFunction& rhs) noexcept
+    {
+        if (rhs.ops_)
+        {
+            rhs.ops_->relocate(&storage_, &rhs.storage_);
+            ops_ = rhs.ops_;
+            rhs.ops_ = nullptr;
+        }
+    }
+
+    void reset() noexcept
+    {
+        if (ops_)
+        {
+            ops_->destroy(&storage_);
+            ops_ = nullptr;
+        }
+    }
+
+    Storage storage_;   // 内联存储
+    const Ops* ops_;    // 当前保存的可调用对象的操作表, 为空表示没有保存任何对象
+};
\ No newline at end of file
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "Poller.h"
+#include "Timestamp.h"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+/**
+ * IoUringPoller 是基于 io_uring 的就绪事件轮询后端, 行为与 EPollPoller 一致(水平触发)
+ * - 每个 Channel 对应一个单次触发的 IORING_OP_POLL_ADD 请求, 事件返回后在下一次 poll 时重新提交,
+ *   重新提交时内核会立即检查当前状态, 因此数据没读完时仍会再次上报, 保持水平触发语义
+ * - 重新提交、修改和删除监听的请求先放在提交队列中, 与等待事件合并成一次 io_uring_enter 系统调用,
+ *   不再像 epoll 那样每次修改监听都要调用一次 epoll_ctl
+ * - 只使用内核接口(linux/io_uring.h)和原始系统调用, 不依赖 liburing
+ * - 内核不支持时 create() 返回 nullptr, 由调用方回退到 EPollPoller
+ */
+class IoUringPoller : public Poller
+{
+   public:
+    // 创建 io_uring 实例, 失败时返回 nullptr
+    static IoUringPoller* create(EventLoop* loop);
+    ~IoUringPoller() override;
+
+    Timestamp poll(int timeoutMs, ChannelList* activeChannels) override;
+    void updateChannel(Channel* channel) override;
+    void removeChannel(Channel* channel) override;
+    // poll 请求只有水平触发语义
+    bool supportsEdgeTriggered() const override { return false; }
+
+   private:
+    // 每个 fd 的轮询状态
+    struct PollState
+    {
+        PollState() : generation(0), armed(false), pendingRearm(false) {}
+        uint32_t generation;  // 每次重新注册时递增, 用于丢弃过期的完成事件
+        bool armed;           // 是否有已提交、尚未完成的 POLL_ADD 请求
+        bool pendingRearm;    // 事件已返回, 等待下一次 poll 时重新提交
+    };
+
+    static const int kEntries = 1024;           // 提交队列的长度
+    static const uint64_t kIgnoredUserData = ~0ULL;  // 不需要处理完成事件的请求(如 POLL_REMOVE)
+
+    explicit IoUringPoller(EventLoop* loop);
+    // 创建并映射 io_uring 的队列, 失败时返回 false
+    bool init();
+
+    // 提交监听/取消监听请求
+    void arm(Channel* channel);
+    void disarm(int fd);
+    // 获取一个空闲的提交队列项, 队列满时先把已有请求提交给内核
+    io_uring_sqe* getSqe();
+    // 提交所有待提交的请求, 并等待至少 waitNr 个完成事件
+    int enter(unsigned waitNr, int timeoutMs);
+    // 取出所有完成事件, 填充活跃的 Channel
+    int reapCompletions(ChannelList* activeChannels);
+    PollState& stateOf(int fd);
+
+    int ringFd_;               // io_uring 实例的 fd
+    unsigned sqEntries_;       // 提交队列长度
+
+    // 映射到用户态的队列
+    void* sqRing_;
+    size_t sqRingSize_;
+    void* cqRing_;
+    size_t cqRingSize_;
+    io_uring_sqe* sqes_;
+    size_t sqesSize_;
+
+    // 提交队列
+    unsigned* sqHead_;
+    unsigned* sqTail_;
+    unsigned* sqMask_;
+    unsigned* sqArray_;
+    // 完成队列
+    unsigned* cqHead_;
+    unsigned* cqTail_;
+    unsigned* cqMask_;
+    io_uring_cqe* cqes_;
+
+    std::vector<PollState> states_;  // 按 fd 索引的轮询状态
+    std::vector<int> rearmFds_;      // 等待重新提交监听的 fd
+};
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <functional>
+#include <stdio.h>
+#include <string>
+#include <sys/types.h>
+#include <time.h>
+
+#include "noncopyable.h"
+
+/**
+ * LogFile 是按大小和日期滚动的日志文件, 只由日志的后台线程使用, 不加锁
+ * - 文件名为 basename.YYYYmmdd-HHMMSS.主机名.pid.log
+ * - 写入超过 rollSize 字节或跨过零点时换一个新文件
+ * - 每次打开新文件后调用 RollCallback, 可以在其中写入文件头(如二进制日志的格式字符串表)
+ */
+class LogFile : noncopyable
+{
+   public:
+    using RollCallback = std::function<void(LogFile*)>;
+
+    LogFile(const std::string& basename, off_t rollSize, RollCallback cb = RollCallback());
+    ~LogFile();
+
+    void append(const char* data, size_t len);
+    void flush();
+
+   private:
+    static const int kRollPerSeconds = 60 * 60 * 24;  // 按天滚动
+    static const size_t kFileBufferSize = 64 * 1024;  // 文件的用户态缓冲区大小
+
+    // 关闭当前文件, 打开一个新文件
+    void rollFile();
+    static std::string getLogFileName(const std::string& basename, time_t now);
+
+    const std::string basename_;
+    const off_t rollSize_;
+    RollCallback rollCallback_;
+    off_t writtenBytes_;    // 当前文件已写入的字节数
+    time_t startOfPeriod_;  // 当前文件所属的日期(按天取整的秒数)
+    FILE* fp_;
+    char buffer_[kFileBufferSize];
+};
\ No newline at end of file
@@ -1,75 +1,135 @@
 #pragma once
 
+#include <atomic>
+#include <stdlib.h>
 #include <string>
+#include <sys/types.h>
 
+#include "BinaryLogging.h"
 #include "noncopyable.h"
 
-// LOG_INFO("%s %d", arg1, arg2)
-#define LOG_INFO(logmsgFormat, ...)                       \
-    do                                                    \
-    {                                                     \
-        Logger &logger = Logger::getinstance();           \
-        logger.setLogLevel(INFO);                         \
-        char buf[1024] = {0};                             \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf);                                  \
+// 定义日志的级别, 数值越大越严重  DEBUG < INFO < ERROR < FATAL
+enum LogLevel
+{
+    DEBUG, // 调试信息
+    INFO,  // 普通信息
+    ERROR, // 错误信息
+    FATAL, // core信息
+};
+
+// 编译期日志级别下限(0=DEBUG 1=INFO 2=ERROR): 低于该级别的 LOG_* 调用在预处理阶段被整个移除
+// 未指定时, 定义了 MUDEBUG 为 DEBUG, 否则为 INFO; 可用 -DMUDUO_LOG_MIN_LEVEL=2 连 INFO 一起移除
+#ifndef MUDUO_LOG_MIN_LEVEL
+#ifdef MUDEBUG
+#define MUDUO_LOG_MIN_LEVEL 0
+#else
+#define MUDUO_LOG_MIN_LEVEL 1
+#endif
+#endif
+
+// 先检查运行期的最低级别, 被过滤的日志既不格式化, 也不对参数求值
+// 二进制模式下只记录调用点 id 和原始参数, 由离线工具格式化
+#define LOG_IMPL(level, logmsgFormat, ...)                                                 \
+    do                                                                                     \
+    {                                                                                      \
+        if (Logger::logLevel() <= level)                                                   \
+        {                                                                                  \
+            if (Logger::binaryEnabled())                                                   \
+            {                                                                              \
+                static BinaryLogSite muduoLogSite = {                                      \
+                    level, logmsgFormat, __FILE__, __LINE__, {0}};                         \
+                BinaryLogging::log(&muduoLogSite, ##__VA_ARGS__);                          \
+            }                                                                              \
+            else                                                                           \
+            {                                                                              \
+                Logger::getinstance().log(level, logmsgFormat, ##__VA_ARGS__);             \
+            }                                                                              \
+        }                                                                                  \
     } while (0)
 
-#define LOG_ERROR(logmsgFormat, ...)                      \
-    do                                                    \
-    {                                                     \
-        Logger &logger = Logger::getinstance();           \
-        logger.setLogLevel(ERROR);                        \
-        char buf[1024] = {0};                             \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf);                                  \
+// LOG_INFO("%s %d", arg1, arg2)
+#if MUDUO_LOG_MIN_LEVEL <= 1
+#define LOG_INFO(logmsgFormat, ...) LOG_IMPL(INFO, logmsgFormat, ##__VA_ARGS__)
+#else
+#define LOG_INFO(logmsgFormat, ...) \
+    do                              \
+    {                               \
     } while (0)
+#endif
 
-#define LOG_FATAL(logmsgFormat, ...)                      \
-    do                                                    \
-    {                                                     \
-        Logger &logger = Logger::getinstance();           \
-        logger.setLogLevel(FATAL);                        \
-        char buf[1024] = {0};                             \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf);                                  \
-        exit(-1);                                         \
+#if MUDUO_LOG_MIN_LEVEL <= 2
+#define LOG_ERROR(logmsgFormat, ...) LOG_IMPL(ERROR, logmsgFormat, ##__VA_ARGS__)
+#else
+#define LOG_ERROR(logmsgFormat, ...) \
+    do                               \
+    {                                \
     } while (0)
+#endif
 
-#ifdef MUDEBUG
-#define LOG_DEBUG(logmsgFormat, ...)                      \
-    do                                                    \
-    {                                                     \
-        Logger &logger = Logger::getinstance();           \
-        logger.setLogLevel(DEBUG);                        \
-        char buf[1024] = {0};                             \
-        snprintf(buf, 1024, logmsgFormat, ##__VA_ARGS__); \
-        logger.log(buf);                                  \
+// FATAL 日志不受级别限制, 总是以文本格式写出, 并刷新所有缓冲的日志后终止进程
+#define LOG_FATAL(logmsgFormat, ...)                                   \
+    do                                                                 \
+    {                                                                  \
+        Logger::getinstance().log(FATAL, logmsgFormat, ##__VA_ARGS__); \
+        exit(-1);                                                      \
     } while (0)
+
+#if MUDUO_LOG_MIN_LEVEL <= 0
+#define LOG_DEBUG(logmsgFormat, ...) LOG_IMPL(DEBUG, logmsgFormat, ##__VA_ARGS__)
 #else
-#define LOG_DEBUG(logmsgFormat, ...)
+#define LOG_DEBUG(logmsgFormat, ...) \
+    do                               \
+    {                                \
+    } while (0)
 #endif
 
-// 定义日志的级别  INFO  ERROR  FATAL  DEBUG
-enum LogLevel
-{
-    INFO,  // 普通信息
-    ERROR, // 错误信息
-    FATAL, // core信息
-    DEBUG, // 调试信息
-};
+class AsyncLogging;
 
 // 输出一个日志类
+// 默认同步写到标准输出; startAsync() 之后各线程只把日志追加到自己的前端缓冲区,
+// 由后台线程批量交换出来写入滚动文件; startBinary() 之后改为二进制延迟格式化日志(FATAL 除外)
 class Logger : noncopyable
 {
 public:
     // 获取日志唯一的实例对象
     static Logger &getinstance();
-    // 设置日志级别
-    void setLogLevel(int level);
-    // 写日志
-    void log(std::string msg);
+
+    // 运行期最低日志级别(默认与编译期下限相同), 可以在任意线程读取和设置
+    static int logLevel() { return logLevel_.load(std::memory_order_relaxed); }
+    static void setLogLevel(int level) { logLevel_.store(level, std::memory_order_relaxed); }
+
+    // 写日志  [级别信息]time : msg
+    void log(int level, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+    // 开启异步日志, 只能调用一次
+    // basename 为空时写到标准输出, 否则写入 basename.时间.主机名.pid.log, 超过 rollSize 字节或跨天时滚动
+    // flushInterval 为后台线程的刷新间隔(秒)
+    void startAsync(const std::string &basename = std::string(),
+                    off_t rollSize = 64 * 1024 * 1024,
+                    int flushInterval = 1);
+    // 停止后台线程并写出所有缓冲的日志, 之后的日志回到同步输出
+    void stopAsync();
+
+    // 开启二进制日志, 只能调用一次; 文件命名和滚动规则与 startAsync 相同
+    // ringBytes 为每个线程无锁环形队列的大小, 队列满时丢弃日志并在文件中记录丢弃的数量
+    void startBinary(const std::string &basename,
+                     size_t ringBytes = 1024 * 1024,
+                     off_t rollSize = 64 * 1024 * 1024);
+    // 停止二进制日志并写出队列中的记录, 之后回到文本日志
+    void stopBinary();
+    static bool binaryEnabled() { return binary_.load(std::memory_order_relaxed); }
+    // 写出所有已缓冲的日志(异步模式下等待后台线程写完)
+    void flush();
 
 private:
-    int logLevel_;
+    Logger();
+    ~Logger();
+
+    // 同步输出一条日志
+    void output(const char *data, size_t len);
+
+    static std::atomic<int> logLevel_;           // 运行期最低日志级别
+    static std::atomic<bool> binary_;            // 是否处于二进制日志模式
+    std::atomic<AsyncLogging *> async_;          // 开启异步日志后的后端, 未开启时为 nullptr
+    std::atomic<BinaryLogging *> binaryLogging_; // 开启二进制日志后的后端, 未开启时为 nullptr
 };
\ No newline at end of file
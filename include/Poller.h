@@ -3,8 +3,8 @@
 /**
  * muduo库中多路事件分发器的核心IO复用模块
  */
+#include <stdint.h>
 #include <vector>
-#include <unordered_map>
 #include "noncopyable.h"
 #include "Timestamp.h"
 
@@ -29,15 +29,52 @@ public:
 
     // 判断参数channel是否在当前Poller中
     bool hasChannel(Channel *channel) const;
+    // 是否支持边缘触发模式的 Channel
+    virtual bool supportsEdgeTriggered() const { return true; }
     // EventLoop通过此接口获取默认的IO接口复用的具体实现
     static Poller *newDefaultPoller(EventLoop *loop);
 
 protected:
-    // map的key: sockfd，value: sockfd所属的channel通道类型
-    using ChannelMap = std::unordered_map<int, Channel *>;
+    // Channel 在 Poller 中的状态
+    static const int kNew = -1;    // 未添加到poller中(初始状态)
+    static const int kAdded = 1;   // 已添加到poller中(内核正在监听)
+    static const int kDeleted = 2; // 仍在表中, 但内核已不再监听(不关心任何事件)
 
-    ChannelMap channels_; // 存储所有注册的Channel
+    // 按 fd 索引的 Channel 表项
+    struct ChannelSlot
+    {
+        ChannelSlot() : channel(nullptr), generation(0), state(kNew) {}
+        Channel *channel;    // 占用该 fd 的 Channel, 空表项为 nullptr
+        uint32_t generation; // 每次有新的 Channel 占用该 fd 时加一, 用于识别过期的事件
+        int state;           // channel 在 Poller 中的状态
+    };
+
+    // 返回 channel 所在的表项, 不在表中时返回 nullptr
+    ChannelSlot *findSlot(const Channel *channel);
+    // 按 fd 和代数查找 Channel, 表项已被其他 Channel 占用或已清空时返回 nullptr
+    Channel *findChannel(int fd, uint32_t generation) const
+    {
+        size_t idx = static_cast<size_t>(fd);
+        return idx < channels_.size() && channels_[idx].generation == generation ? channels_[idx].channel
+                                                                                : nullptr;
+    }
+    // 返回占用 fd 的 Channel, 空表项返回 nullptr
+    Channel *channelOf(int fd) const
+    {
+        size_t idx = static_cast<size_t>(fd);
+        return idx < channels_.size() ? channels_[idx].channel : nullptr;
+    }
+    // 让 channel 占用其 fd 对应的表项(代数加一, 状态为 kNew), 返回该表项
+    ChannelSlot &insertChannel(Channel *channel);
+    // 清空 fd 对应的表项
+    void eraseChannel(int fd);
+    // 表中的 Channel 数量
+    size_t numChannels() const { return numChannels_; }
 
 private:
+    // 下标为 sockfd 的稠密表: fd 是从小整数开始分配的, 增删改查都是一次数组访问, 不分配节点
+    std::vector<ChannelSlot> channels_;
+    size_t numChannels_; // 表中的 Channel 数量
+
     EventLoop *ownerLoop_; // 定义Poller所属的事件循环EventLoop
 };
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "Buffer.h"
+
+/**
+ * Slice 是一段不可变的、引用计数共享的字节序列
+ * - 通过移动构造接管 std::string / Buffer 的存储, 不拷贝数据
+ * - 拷贝 Slice 只增加引用计数, 适合在线程之间传递大块数据(如跨线程 send)
+ * - 最后一个引用释放时底层存储才被释放
+ */
+class Slice
+{
+   public:
+    Slice() : data_(nullptr), size_(0) {}
+    // 接管字符串的存储
+    explicit Slice(std::string&& str)
+    {
+        std::shared_ptr<std::string> owner = std::make_shared<std::string>(std::move(str));
+        data_ = owner->data();
+        size_ = owner->size();
+        owner_ = std::move(owner);
+    }
+    // 接管 Buffer 中的可读数据(分段模式的 Buffer 会先合并为连续数据)
+    explicit Slice(Buffer&& buf)
+    {
+        std::shared_ptr<Buffer> owner = std::make_shared<Buffer>(std::move(buf));
+        data_ = owner->peek();
+        size_ = owner->readableBytes();
+        owner_ = std::move(owner);
+    }
+    // 拷贝一份 [data, data+len) 的数据
+    Slice(const char* data, size_t len) : Slice(std::string(data, len)) {}
+    // 引用由 owner 保活的外部内存 [data, data+len)
+    Slice(std::shared_ptr<const void> owner, const char* data, size_t len)
+        : owner_(std::move(owner)), data_(data), size_(len)
+    {
+    }
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    // 返回 [offset, offset+len) 部分, 与原 Slice 共享同一份存储
+    Slice subslice(size_t offset, size_t len) const
+    {
+        offset = std::min(offset, size_);
+        return Slice(owner_, data_ + offset, std::min(len, size_ - offset));
+    }
+
+   private:
+    std::shared_ptr<const void> owner_;  // 保活底层存储
+    const char* data_;                   // 数据起始地址
+    size_t size_;                        // 数据长度
+};
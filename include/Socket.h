@@ -32,6 +32,13 @@ class Socket : noncopyable
     void setReusePort(bool on);
     // 设置 SO_KEEPALIVE 选项
     void setKeepAlive(bool on);
+    // 设置 SO_ZEROCOPY 选项, 内核不支持时返回 false
+    bool setZeroCopy(bool on);
+    // 设置 SO_BUSY_POLL 选项: 阻塞读取时在网卡队列上忙等 usec 微秒, 0 表示关闭; 失败(如权限不足)时返回 false
+    bool setBusyPoll(int usec);
+    // 为 SO_REUSEPORT 组挂载 CBPF 程序: 在第 cpu 号 CPU 上收到的连接交给组内第 cpu % groupSize 个 socket
+    // (组内序号即 listen 的顺序); 对组内任一 socket 设置即对整个组生效, 失败时返回 false
+    bool setReusePortCpuSteering(int groupSize);
 
    private:
     const int sockfd_;  // socket fd
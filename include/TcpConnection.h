@@ -1,13 +1,22 @@
 #pragma once
 
 #include <atomic>
+#include <deque>
 #include <memory>
+#include <mutex>
+#include <stdint.h>
 #include <string>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <vector>
 
 #include "Buffer.h"
 #include "Callbacks.h"
 #include "InetAddress.h"
+#include "InplaceFunction.h"
+#include "Slice.h"
 #include "Timestamp.h"
+#include "TimingWheel.h"
 #include "noncopyable.h"
 
 class Channel;
@@ -18,12 +27,15 @@ class Socket;
 class TcpConnection : noncopyable, public std::enable_shared_from_this<TcpConnection>
 {
    public:
+    static const size_t kDefaultHighWaterMark = 64 * 1024 * 1024;  // 默认高水位 64M
+
     TcpConnection(EventLoop* loop, const std::string& nameArg, int sockfd,
                   const InetAddress& localAddr, const InetAddress& peerAddr);
     ~TcpConnection();
 
     // 获取相关信息的接口
-    EventLoop* getLoop() const { return loop_; }
+    // 连接可能被迁移到其他 loop: 不要跨迁移缓存返回值, 操作连接请使用连接自身的接口(会投递到迁移后的 loop)
+    EventLoop* getLoop() const { return loop_.load(std::memory_order_acquire); }
     const std::string& name() const { return name_; }
     const InetAddress& localAddress() const { return localAddr_; }
     const InetAddress& peerAddress() const { return peerAddr_; }
@@ -33,9 +45,40 @@ class TcpConnection : noncopyable, public std::enable_shared_from_this<TcpConnec
     bool disconnected() const { return state_ == kDisconnected; }
 
     // 向对端发送数据
-    void send(const std::string& buf);
+    // 在所属loop线程中调用时直接发送; 在其他线程中调用时, 数据连同连接自身的引用一起转交给所属loop
+    void send(const std::string& buf);  // 跨线程时拷贝一次
+    void send(std::string&& buf);       // 跨线程时接管字符串存储, 不拷贝
+    void send(Buffer&& buf);            // 跨线程时接管 Buffer 存储, 不拷贝
+    void send(const Slice& slice);      // 跨线程时只增加引用计数
+    // 以上三个接管存储的重载在开启零拷贝且数据量达到阈值时使用 MSG_ZEROCOPY 发送,
+    // 数据会被一直持有, 直到内核通过错误队列确认不再引用它(可借助 Slice 的 owner 感知释放时机);
+    // 连接析构时仍未确认的数据连同 socket 一起延后释放, 对端长时间不接收时以 RST 关闭后释放
+    // 聚集写: 把多段数据按顺序作为一个整体发送, 可写时用一次 writev 提交,
+    // 只有内核未接收的剩余部分才拷贝进 outputBuffer_
+    void sendv(const struct iovec* iov, int iovcnt);  // 跨线程时拼接拷贝一次
+    void sendv(const std::vector<Slice>& slices);     // 跨线程时只增加引用计数
+    // 发送文件 fd 中 [offset, offset+len) 的内容, 由内核通过 sendfile 直接写入socket
+    // 与 send 的数据严格按调用顺序发送; 内部会 dup 一份 fd, 调用方可在返回后立即关闭自己的 fd
+    // 全部发送完毕后触发 writeCompleteCallback_
+    void sendFile(int fd, off_t offset, size_t len);
     // 关闭连接
-    void shutdown();  // 关闭写端
+    void shutdown();    // 关闭写端
+    void forceClose();  // 直接关闭连接, 丢弃尚未发送的数据
+
+    // 读端流量控制: 停止/恢复关注读事件, 暂停期间数据积压在内核接收缓冲区, 由TCP窗口向对端施加反压
+    // 可在任意线程调用, 实际操作在所属loop中执行
+    void startRead();
+    void stopRead();
+    bool isReading() const { return reading_; }
+    // 设置接收缓冲区上限(0 表示不限制, 默认): messageCallback 返回后 inputBuffer_ 中仍积压
+    // 不少于 bytes 字节时自动暂停读取; 暂停期间所属loop每轮循环末尾检查一次, 应用在loop线程中通过
+    // inputBuffer() 取走数据、积压低于 bytes 后自动恢复读取(被 stopRead() 暂停的除外), 不需要调用 startRead()
+    void setInputBufferLimit(size_t bytes) { inputBufferLimit_ = bytes; }
+    // 设置空闲超时: 连续 seconds 秒没有收到数据则强制关闭连接(0 表示不限制, 默认)
+    // 由所属loop的时间轮计时, 需在连接建立前调用
+    void setIdleTimeout(double seconds) { idleTimeout_ = seconds; }
+    // 接收缓冲区, 只能在所属loop线程中访问
+    Buffer* inputBuffer() { return &inputBuffer_; }
 
     // 设置回调函数
     void setConnectionCallback(const ConnectionCallback& cb) { connectionCallback_ = cb; }
@@ -46,13 +89,46 @@ class TcpConnection : noncopyable, public std::enable_shared_from_this<TcpConnec
         highWaterMarkCallback_ = cb;
         highWaterMark_ = highWaterMark;
     }
+    // 发送缓冲区达到高水位后, 回落到 lowWaterMark 字节及以下时调用一次 cb(用于恢复生产数据)
+    // 高/低水位之间构成回差, 两个回调总是交替触发
+    void setLowWaterMarkCallback(const LowWaterMarkCallback& cb, size_t lowWaterMark)
+    {
+        lowWaterMarkCallback_ = cb;
+        lowWaterMark_ = lowWaterMark;
+    }
     void setCloseCallback(const CloseCallback& cb) { closeCallback_ = cb; }
+    // 设置缓冲区读空/写空后是否立即把存储区归还内存池(默认开启, 空闲连接不占用缓冲区内存)
+    void setShrinkBuffersWhenDrained(bool on) { shrinkBuffersWhenDrained_ = on; }
+    // 设置自动合并写: 开启后同一轮事件循环内的多次 send 先追加到 outputBuffer_,
+    // 在本轮循环末尾用一次 writev 统一发送(默认关闭); 需在连接建立前或所属loop线程中调用
+    void setAutoCork(bool on) { autoCork_ = on; }
+    // 设置边缘触发模式: 可写事件只注册一次, 读写都持续到 EAGAIN 为止, 省去每轮写的 epoll_ctl
+    // 需在连接建立前调用; Poller 不支持边缘触发(如 io_uring)时自动回落到水平触发
+    void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+    // 对不小于 threshold 字节的数据启用 MSG_ZEROCOPY 发送, 0 表示关闭(默认)
+    // 需在连接建立前或所属loop线程中调用; 内核不支持 SO_ZEROCOPY 时返回 false
+    bool setZeroCopyThreshold(size_t threshold);
+    // 为连接的socket设置 SO_BUSY_POLL(微秒), 配合 EventLoop::setBusyPoll 降低唤醒延迟
+    bool setSocketBusyPoll(int usec);
+
+    // 把连接迁移到另一个 loop: Channel、收发缓冲区、排队的输出和空闲超时随连接一起转移,
+    // 内核中尚未读取的数据留在socket上, 由新的 loop 继续读取, 不丢数据也不乱序
+    // 可在任意线程调用; 只迁移处于连接状态的连接, cb 在迁移结束后连接所属的 loop 中执行
+    // 迁移期间发起的 send/shutdown 等操作先暂存, 迁移完成后在新的 loop 中按调用顺序执行
+    void migrateTo(EventLoop* loop, const MigrateCallback& cb = MigrateCallback());
+    // 累计接收的字节数(可在任意线程读取), 用于估算连接的负载
+    uint64_t bytesReceived() const { return bytesReceived_.load(std::memory_order_relaxed); }
 
     // 连接建立和销毁
     void connectEstablished();  // 连接建立后调用，注册Channel到Poller
     void connectDestroyed();    // 连接销毁前调用，从Poller移除Channel
+    // 在所属loop中执行 connectDestroyed, 可在任意线程调用; 迁移期间暂存, 迁移完成后在新的loop中执行
+    // queue 为 false 且当前就在所属loop线程时立即执行
+    void destroy(bool queue = true);
 
    private:
+    using Functor = InplaceFunction<void()>;
+
     enum State  // 连接状态枚举
     {
         kDisconnected,
@@ -65,19 +141,69 @@ class TcpConnection : noncopyable, public std::enable_shared_from_this<TcpConnec
 
     // Channel的回调处理函数
     void handleRead(Timestamp receiveTime);
+    // 执行一次读取并分发数据, 读到数据时返回 true(边缘触发模式下需要继续读)
+    bool handleReadOnce(Timestamp receiveTime, bool edgeTriggered);
     void handleWrite();
     void handleClose();
     void handleError();
+    // 读取socket错误队列中的零拷贝完成通知, 释放内核已不再引用的数据
+    bool handleErrorQueue();
 
     // 在所属的loop中执行发送/关闭操作
     void sendInLoop(const void* data, size_t len);
+    void sendSliceInLoop(const Slice& slice);
+    void sendvInLoop(const struct iovec* iov, int iovcnt);
+    void sendSlicesInLoop(const std::vector<Slice>& slices);
+    void sendFileInLoop(int fileFd, off_t offset, size_t len);
+    void sendZeroCopyInLoop(const Slice& slice);
+    // 数据量是否达到零拷贝发送的阈值
+    bool zeroCopyEligible(size_t len) const
+    {
+        return zeroCopyThreshold_ > 0 && len >= zeroCopyThreshold_;
+    }
+    // 有新的排队输出时: 若当前没有在等待可写事件, 立即尝试发送, 发不完再关注写事件
+    void startPendingOutput();
+    // 自动合并写模式下, 在本轮事件循环末尾发送本轮积累的数据
+    void flushCorkedOutput();
+    // 依次发送 outputBuffer_ 和排队的文件/零拷贝数据, 直到全部发完或内核发送缓冲区写满,
+    // 返回本次写入的字节数
+    ssize_t writeOutput(int* saveErrno);
+    // 返回尚未发送的缓冲数据总量(不含文件内容和零拷贝数据)
+    size_t bufferedOutputBytes() const;
+    // 发送了数据后检查是否已回落到低水位
+    void checkLowWaterMark();
+    // 关闭并丢弃所有尚未发送的文件和零拷贝数据
+    void clearPendingOutputs();
     void shutdownInLoop();
+    void forceCloseInLoop();
+    // 空闲超时到期
+    void handleIdleTimeout();
+    void startReadInLoop();
+    void stopReadInLoop();
+    // 根据 reading_ 和接收缓冲区上限更新 Channel 的读事件关注
+    void updateReadInterest();
+    // 因积压达到上限而暂停读取期间, 每轮循环末尾检查一次积压是否已回落
+    void checkInputBufferLimit(EventLoop* loop);
+
+    // 当前线程是否可以直接操作连接: 位于所属loop线程且连接不在迁移中
+    bool inOwnerLoop() const;
+    // 在所属loop中执行 op(queue 为 true 时总是排队执行), 迁移期间暂存到 migrationBacklog_
+    void runInOwnerLoop(Functor op, bool queue = false);
+    // 连接迁移的三个阶段: 原loop摘除 Channel -> 原loop排空旧的投递 -> 新loop重新注册并重放暂存的操作
+    void migrateInLoop(EventLoop* loop, const MigrateCallback& cb);
+    void migrateHandoff(EventLoop* loop, bool idle, const MigrateCallback& cb);
+    void connectMigrated(bool idle, const MigrateCallback& cb);
 
    private:
-    EventLoop* loop_;  // 这里不是baseLoop，因为TcpConnection是在subLoop里面管理的
+    // 这里不是baseLoop，因为TcpConnection是在subLoop里面管理的; 迁移时会改变, 因此是原子量
+    std::atomic<EventLoop*> loop_;
     const std::string name_;  // 连接名称
     std::atomic_int state_;   // 连接状态
     bool reading_;            // 是否正在读取数据(用于控制Channel的读事件关注)
+    size_t inputBufferLimit_;  // 接收缓冲区上限, 积压达到上限时自动暂停读取, 0 表示不限制
+    bool limitCheckQueued_;    // 已登记积压回落的检查
+    double idleTimeout_;       // 空闲超时(秒), 0 表示不限制
+    TimingWheel::Entry idleEntry_;  // 空闲超时在时间轮中的节点, 每次收到数据时刷新
 
     std::unique_ptr<Socket> socket_;    // 封装connfd
     std::unique_ptr<Channel> channel_;  // 封装connfd对应的事件
@@ -90,10 +216,67 @@ class TcpConnection : noncopyable, public std::enable_shared_from_this<TcpConnec
     MessageCallback messageCallback_;              // 消息到达回调
     WriteCompleteCallback writeCompleteCallback_;  // 数据发送完毕回调 (outputBuffer 清空时)
     HighWaterMarkCallback highWaterMarkCallback_;  // 输出缓冲区高水位回调
+    LowWaterMarkCallback lowWaterMarkCallback_;    // 输出缓冲区回落到低水位的回调
     CloseCallback closeCallback_;                  // 连接关闭回调 (通知 TCPServer)
     size_t highWaterMark_;                         // 高水位阈值
+    size_t lowWaterMark_;                          // 低水位阈值
+    bool aboveHighWaterMark_;                      // 已触发高水位, 尚未回落到低水位
+    bool shrinkBuffersWhenDrained_;                // 缓冲区排空后是否归还存储区
+    bool autoCork_;                                // 是否开启自动合并写
+    bool corkFlushQueued_;                         // 本轮循环是否已登记合并写的发送
+    bool edgeTriggered_;                           // 是否请求边缘触发模式
+
+    // 排在 outputBuffer_ 之后、不经过发送缓冲区的输出: 文件区间(sendfile)或零拷贝数据(MSG_ZEROCOPY)
+    struct PendingOutput
+    {
+        PendingOutput()
+            : fileFd(-1),
+              offset(0),
+              remaining(0),
+              trailer(Buffer::kInitialSize, Buffer::kSegmented)
+        {
+        }
+
+        int fileFd;        // 文件: dup 得到的文件描述符, 发送完毕后关闭; 零拷贝数据为 -1
+        off_t offset;      // 文件: 下一次发送的文件偏移
+        Slice slice;       // 零拷贝数据: 待发送的数据, 从 slice.size() - remaining 处继续发送
+        size_t remaining;  // 剩余未发送的字节数
+        Buffer trailer;    // 在这段输出之后调用 send 的数据, 它发完后接到 outputBuffer_
+    };
+    // 已提交给内核、等待完成通知的零拷贝数据
+    struct ZeroCopyInflight
+    {
+        uint32_t id;   // 内核为每次成功的 MSG_ZEROCOPY 发送分配的递增序号
+        Slice slice;   // 持有数据, 收到完成通知后释放
+    };
+    // 连接销毁时内核仍在引用的零拷贝数据: 接管 socket 和数据, 完成通知全部到达后才关闭并释放
+    struct ZeroCopyLinger;
+    // 在 connectDestroyed 中把仍未完成的零拷贝数据交给 ZeroCopyLinger
+    void lingerZeroCopy();
+    // 读取 fd 错误队列中的零拷贝完成通知, 释放内核不再引用的数据; 收到过通知时返回 true
+    static bool reapZeroCopyCompletions(int fd, std::deque<ZeroCopyInflight>* inflight);
+    static void checkZeroCopyLinger(EventLoop* loop, const std::shared_ptr<ZeroCopyLinger>& linger);
+    static const size_t kMaxSendfileChunk = 1024 * 1024;  // 单次 sendfile 的最大字节数
 
     // 数据缓冲区
     Buffer inputBuffer_;   // 接收缓冲区
-    Buffer outputBuffer_;  // 发送缓冲区
+    Buffer outputBuffer_;  // 发送缓冲区(分段模式)
+    std::deque<PendingOutput> pendingOutputs_;  // 等待发送的文件和零拷贝数据
+
+    // 零拷贝发送
+    size_t zeroCopyThreshold_;                       // 零拷贝阈值, 0 表示关闭
+    uint32_t zeroCopyNextId_;                        // 下一次零拷贝发送的序号
+    std::deque<ZeroCopyInflight> zeroCopyInflight_;  // 等待内核完成通知的数据
+
+    std::atomic<uint64_t> bytesReceived_;  // 累计接收的字节数
+
+    // 连接迁移
+    std::atomic_bool migrating_;  // 正在迁移: 新的操作暂存, 不再投递到 loop_
+    std::atomic_int callers_;     // 正在按 loop_ 投递操作的线程数, 迁移需等它们投递完成
+    std::mutex migrateMutex_;     // 保护 migrationBacklog_ 和迁移结束时对 migrating_ 的清除
+    std::vector<Functor> migrationBacklog_;  // 迁移期间发起的操作
+    // 迁移开始前已投递到原loop、迁移期间才执行到的操作, 它们都发生在 migrationBacklog_ 之前
+    // 先后只由原loop和新loop访问(两者之间通过 queueInLoop 交接)
+    std::vector<Functor> staleOps_;
+    bool replayingOps_;  // 迁移完成后正在重放暂存的操作
 };
\ No newline at end of file
@@ -3,8 +3,10 @@
 #include <atomic>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "Acceptor.h"
 #include "Buffer.h"
@@ -24,6 +26,9 @@ class TcpServer : noncopyable
     {
         kNoReusePort,
         kReusePort,
+        // 每个 Sub Loop 各自持有一个以 SO_REUSEPORT 绑定的监听 socket, 由内核按四元组哈希分配新连接,
+        // 连接在接受它的 loop 中建立, 不经过 mainLoop; 此时 setLoadBalance/setLoopSelector 不起作用
+        kReusePortPerLoop,
     };
 
     TcpServer(EventLoop* loop, const InetAddress& listenAddr, const std::string& nameArg,
@@ -36,18 +41,77 @@ class TcpServer : noncopyable
     void setConnectionCallback(const ConnectionCallback& cb) { connectionCallback_ = cb; }
     void setMessageCallback(const MessageCallback& cb) { messageCallback_ = cb; }
     void setWriteCompleteCallback(const WriteCompleteCallback& cb) { writeCompleteCallback_ = cb; }
+    // 设置新连接的发送缓冲区高/低水位及回调(见 TcpConnection::setHighWaterMarkCallback)
+    void setHighWaterMarkCallback(const HighWaterMarkCallback& cb, size_t highWaterMark)
+    {
+        highWaterMarkCallback_ = cb;
+        highWaterMark_ = highWaterMark;
+    }
+    void setLowWaterMarkCallback(const LowWaterMarkCallback& cb, size_t lowWaterMark)
+    {
+        lowWaterMarkCallback_ = cb;
+        lowWaterMark_ = lowWaterMark;
+    }
+    // 设置新连接的缓冲区排空后是否归还存储区(见 TcpConnection::setShrinkBuffersWhenDrained)
+    void setShrinkBuffersWhenDrained(bool on) { shrinkBuffersWhenDrained_ = on; }
+    // 设置新连接的零拷贝发送阈值(见 TcpConnection::setZeroCopyThreshold), 0 表示关闭
+    void setZeroCopyThreshold(size_t threshold) { zeroCopyThreshold_ = threshold; }
+    // 设置新连接是否开启自动合并写(见 TcpConnection::setAutoCork)
+    void setAutoCork(bool on) { autoCork_ = on; }
+    // 设置新连接是否使用边缘触发模式(见 TcpConnection::setEdgeTriggered)
+    void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+    // 设置新连接的接收缓冲区上限(见 TcpConnection::setInputBufferLimit), 0 表示不限制
+    void setInputBufferLimit(size_t bytes) { inputBufferLimit_ = bytes; }
+    // 设置新连接的空闲超时(秒), 超时未收到数据的连接会被强制关闭, 0 表示不限制
+    void setIdleTimeout(double seconds) { idleTimeout_ = seconds; }
+    // 设置新连接socket的 SO_BUSY_POLL(微秒), 0 表示不设置; loop的忙轮询见 EventLoop::setBusyPoll,
+    // 可在 setThreadInitcallback 的回调中为每个IO线程开启
+    void setSocketBusyPoll(int usec) { socketBusyPollUs_ = usec; }
     // 设置EventLoopThreadPool中I/O线程(Sub Loop)的数量
     void setThreadNum(int numThreads);
+    // 设置新连接分配到 Sub Loop 的策略(见 EventLoopThreadPool::LoadBalance), 默认轮询
+    void setLoadBalance(EventLoopThreadPool::LoadBalance strategy)
+    {
+        threadPool_->setLoadBalance(strategy);
+    }
+    // 设置自定义的 Sub Loop 选择函数, 优先于 setLoadBalance
+    void setLoopSelector(const EventLoopThreadPool::LoopSelector& selector)
+    {
+        threadPool_->setLoopSelector(selector);
+    }
+    // kReusePortPerLoop 模式下按 CPU 分发新连接: 在第 cpu 号 CPU 上收到的连接交给第 cpu % N 个 Sub Loop;
+    // 需要把第 i 个 IO线程绑定到第 i 号 CPU(如在 setThreadInitcallback 的回调中), 并让网卡各接收队列的
+    // 中断落在对应的 CPU 上, 接受连接的 CPU 才与接收队列一致。需在 start() 之前调用
+    void setReusePortCpuSteering(bool on) { reusePortCpuSteering_ = on; }
+    // 设置每次监听socket可读时最多接受的连接数(见 Acceptor::setAcceptBatch), 需在 start() 之前调用
+    void setAcceptBatch(int n);
     // 启动服务器
     void start();
+    // 所有 Acceptor 的统计信息之和, start() 之后可以在任意线程读取
+    Acceptor::Stats acceptStats() const;
+
+    // 开启连接重平衡: 每隔 seconds 秒比较各个 Sub Loop 最近的忙碌占比, 最忙与最闲的相差超过 20% 时,
+    // 把最忙的 loop 上的一个连接迁移到最闲的 loop(见 TcpConnection::migrateTo);
+    // 按各连接最近的接收量估算负载, 选择迁移后最接近均衡的连接, 迁移改善不明显时不迁移。
+    // 0 表示关闭(默认), 需在 start() 之前调用
+    void setRebalanceInterval(double seconds) { rebalanceInterval_ = seconds; }
+
+    // IO线程池, start() 之后可以通过 getAllLoops() 读取各个 Sub Loop 的 metrics()
+    std::shared_ptr<EventLoopThreadPool> threadPool() { return threadPool_; }
 
    private:
-    // 处理新连接
+    // 处理新连接(mainLoop 中的 Acceptor)
     void newConnection(int sockfd, const InetAddress& peerAddr);
+    // 在 ioLoop 上建立新连接, 在接受连接的线程中调用
+    void createConnection(EventLoop* ioLoop, int sockfd, const InetAddress& peerAddr);
+    // kReusePortPerLoop 模式下为每个 loop 创建并启动 Acceptor
+    void startLoopAcceptors();
     // 处理连接断开
     void removeConnection(const TcpConnectionPtr& conn);
     // 处理连接断开
     void removeConnectionInLoop(const TcpConnectionPtr& conn);
+    // 连接重平衡, 在 mainLoop 中定期执行
+    void rebalance();
 
     using ConnectionMap = std::unordered_map<std::string, TcpConnectionPtr>;
 
@@ -56,7 +120,14 @@ class TcpServer : noncopyable
     const std::string ipPort_;  // ip:port
     const std::string name_;    // 服务器的名称
 
-    std::unique_ptr<Acceptor> acceptor_;  // 指向Acceptor对象的智能指针，用于监听新连接事件
+    const InetAddress listenAddr_;  // 监听地址
+
+    // 指向Acceptor对象的智能指针，用于监听新连接事件; kReusePortPerLoop 模式下为空
+    std::unique_ptr<Acceptor> acceptor_;
+    // kReusePortPerLoop 模式下各个 loop 的 Acceptor, 与 threadPool_->getAllLoops() 一一对应
+    std::vector<std::unique_ptr<Acceptor>> loopAcceptors_;
+    bool reusePortCpuSteering_;  // 是否按 CPU 分发新连接
+    int acceptBatch_;            // 每次可读事件最多接受的连接数
 
     std::shared_ptr<EventLoopThreadPool>
         threadPool_;  // 指向EventLoopThreadPool对象的智能指针，处理已建立连接上的 I/O 事件
@@ -64,11 +135,29 @@ class TcpServer : noncopyable
     ConnectionCallback connectionCallback_;  // 用户设置的连接回调函数
     MessageCallback messageCallback_;        // 用户设置的消息（读事件）回调函数
     WriteCompleteCallback writeCompleteCallback_;  // 用户设置的写完成回调函数
+    HighWaterMarkCallback highWaterMarkCallback_;  // 用户设置的高水位回调函数
+    LowWaterMarkCallback lowWaterMarkCallback_;    // 用户设置的低水位回调函数
+    size_t highWaterMark_;                         // 新连接的高水位阈值
+    size_t lowWaterMark_;                          // 新连接的低水位阈值
 
     ThreadInitCallback threadInitCallback_;  // 用户设置的线程初始化回调函数
 
+    bool shrinkBuffersWhenDrained_;  // 新连接的缓冲区排空后是否归还存储区
+    size_t zeroCopyThreshold_;       // 新连接的零拷贝发送阈值
+    bool autoCork_;                  // 新连接是否开启自动合并写
+    bool edgeTriggered_;             // 新连接是否使用边缘触发模式
+    size_t inputBufferLimit_;        // 新连接的接收缓冲区上限
+    double idleTimeout_;             // 新连接的空闲超时(秒)
+    int socketBusyPollUs_;           // 新连接socket的 SO_BUSY_POLL(微秒)
+    double rebalanceInterval_;       // 连接重平衡的间隔(秒), 0 表示关闭
+    TimerId rebalanceTimer_;         // 连接重平衡的定时器
+    // 上一次重平衡时各连接的累计接收字节数, 用于计算最近的接收量
+    std::unordered_map<std::string, uint64_t> rebalanceBytes_;
+
     std::atomic_int started_;  // 服务器是否启动的标志
 
-    int nextConnId_;             // 为新连接分配的ID
-    ConnectionMap connections_;  // 存储当前服务器持有的所有活动 TCP 连接
+    std::atomic_int nextConnId_;  // 为新连接分配的ID(kReusePortPerLoop 模式下由多个 loop 分配)
+    // 存储当前服务器持有的所有活动 TCP 连接; kReusePortPerLoop 模式下由各个 loop 插入, 因此由互斥锁保护
+    std::mutex connectionsMutex_;
+    ConnectionMap connections_;
 };
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+#include "Callbacks.h"
+#include "Timestamp.h"
+#include "noncopyable.h"
+
+// 定时器: 记录到期时间、回调以及重复间隔, 由 TimerQueue 管理
+class Timer : noncopyable
+{
+   public:
+    Timer(TimerCallback cb, Timestamp when, double interval)
+        : callback_(std::move(cb)),
+          expiration_(when),
+          interval_(interval),
+          repeat_(interval > 0.0),
+          sequence_(++s_numCreated_)
+    {
+    }
+
+    // 执行定时器回调
+    void run() const { callback_(); }
+
+    Timestamp expiration() const { return expiration_; }
+    bool repeat() const { return repeat_; }
+    int64_t sequence() const { return sequence_; }
+
+    // 重复定时器以 now 为基准计算下一次到期时间
+    void restart(Timestamp now);
+
+   private:
+    const TimerCallback callback_;  // 到期时执行的回调
+    Timestamp expiration_;          // 到期时间
+    const double interval_;         // 重复间隔(秒), 不大于0表示只执行一次
+    const bool repeat_;             // 是否重复执行
+    const int64_t sequence_;        // 全局唯一序号, 用于区分地址相同的定时器
+
+    static std::atomic<int64_t> s_numCreated_;  // 已创建的定时器数量
+};
\ No newline at end of file
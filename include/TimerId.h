@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+
+class Timer;
+
+// 定时器的标识, 由 EventLoop::runAt/runAfter/runEvery 返回, 用于取消定时器
+// 只保存指针和序号, 可以安全地拷贝, 即使定时器已经执行完毕或被取消
+class TimerId
+{
+   public:
+    TimerId() : timer_(nullptr), sequence_(0) {}
+    TimerId(Timer* timer, int64_t seq) : timer_(timer), sequence_(seq) {}
+
+    friend class TimerQueue;
+
+   private:
+    Timer* timer_;
+    int64_t sequence_;
+};
\ No newline at end of file
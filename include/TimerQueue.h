@@ -0,0 +1,59 @@
+#pragma once
+
+#include <set>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+#include "Callbacks.h"
+#include "Channel.h"
+#include "Timestamp.h"
+#include "noncopyable.h"
+
+class EventLoop;
+class Timer;
+class TimerId;
+
+/**
+ * TimerQueue 管理一个 EventLoop 上的所有定时器
+ * - 用 timerfd 表示最早到期的时间点, 作为普通 Channel 注册到 Poller 上, 到期时在loop线程中触发读事件
+ * - 定时器按(到期时间, 地址)有序保存在 std::set 中, 插入和取消都是 O(log n)
+ * - addTimer/cancel 可以在任意线程调用, 实际修改在所属loop中执行
+ */
+class TimerQueue : noncopyable
+{
+   public:
+    explicit TimerQueue(EventLoop* loop);
+    ~TimerQueue();
+
+    // 添加一个定时器, 在 when 时刻执行 cb, interval > 0 时之后每隔 interval 秒重复执行
+    TimerId addTimer(TimerCallback cb, Timestamp when, double interval);
+    // 取消定时器
+    void cancel(TimerId timerId);
+
+   private:
+    using Entry = std::pair<Timestamp, Timer*>;  // 按到期时间排序, 地址用于区分同一时刻的定时器
+    using TimerList = std::set<Entry>;
+    using ActiveTimer = std::pair<Timer*, int64_t>;  // 按(地址, 序号)查找定时器
+    using ActiveTimerSet = std::set<ActiveTimer>;
+
+    void addTimerInLoop(Timer* timer);
+    void cancelInLoop(TimerId timerId);
+    // timerfd 可读: 执行所有到期的定时器
+    void handleRead();
+    // 取出所有到期的定时器
+    std::vector<Entry> getExpired(Timestamp now);
+    // 重新插入重复的定时器, 释放其余定时器, 并更新 timerfd 的到期时间
+    void reset(const std::vector<Entry>& expired, Timestamp now);
+    // 插入定时器, 返回最早到期时间是否因此改变
+    bool insert(Timer* timer);
+
+    EventLoop* loop_;
+    const int timerfd_;
+    Channel timerfdChannel_;
+    TimerList timers_;  // 按到期时间排序的定时器
+
+    ActiveTimerSet activeTimers_;     // 与 timers_ 内容相同, 按地址排序, 用于取消
+    bool callingExpiredTimers_;       // 是否正在执行到期的定时器回调
+    ActiveTimerSet cancelingTimers_;  // 在回调执行期间被取消的定时器, 不再重新插入
+};
\ No newline at end of file
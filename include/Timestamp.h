@@ -1,6 +1,7 @@
 #pragma once
 
 #include <iostream>
+#include <stdint.h>
 #include <string>
 
 // 时间类
@@ -13,9 +14,41 @@ public:
 public:
     // 获取当前的系统时间
     static Timestamp now();
+    // 返回一个无效的时间戳
+    static Timestamp invalid() { return Timestamp(); }
     // 时间戳转字符串
     std::string toString() const;
 
+    // 是否为有效时间戳
+    bool valid() const { return microSecondsSinceEpoch_ > 0; }
+    int64_t microSecondsSinceEpoch() const { return microSecondsSinceEpoch_; }
+
+    static const int kMicroSecondsPerSecond = 1000 * 1000;
+
 private:
-    int64_t microSecondsSinceEpoch_;
-};
\ No newline at end of file
+    int64_t microSecondsSinceEpoch_;  // 自1970-01-01以来的微秒数
+};
+
+inline bool operator<(Timestamp lhs, Timestamp rhs)
+{
+    return lhs.microSecondsSinceEpoch() < rhs.microSecondsSinceEpoch();
+}
+
+inline bool operator==(Timestamp lhs, Timestamp rhs)
+{
+    return lhs.microSecondsSinceEpoch() == rhs.microSecondsSinceEpoch();
+}
+
+// 两个时间点之差, 单位秒
+inline double timeDifference(Timestamp high, Timestamp low)
+{
+    int64_t diff = high.microSecondsSinceEpoch() - low.microSecondsSinceEpoch();
+    return static_cast<double>(diff) / Timestamp::kMicroSecondsPerSecond;
+}
+
+// 在 timestamp 的基础上加上 seconds 秒
+inline Timestamp addTime(Timestamp timestamp, double seconds)
+{
+    int64_t delta = static_cast<int64_t>(seconds * Timestamp::kMicroSecondsPerSecond);
+    return Timestamp(timestamp.microSecondsSinceEpoch() + delta);
+}
\ No newline at end of file
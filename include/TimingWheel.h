@@ -0,0 +1,82 @@
+#pragma once
+
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "InplaceFunction.h"
+#include "TimerId.h"
+#include "noncopyable.h"
+
+class EventLoop;
+
+/**
+ * TimingWheel 是每个 EventLoop 独有的哈希时间轮, 专门处理大量与连接绑定的超时(如空闲踢除)
+ * - 时间轮由 numSlots 个槽组成, 每 tick 秒前进一格, 由 EventLoop 的定时器驱动
+ * - 每个超时对应一个嵌入在使用者对象中的 Entry, 槽内用侵入式双向链表串联, 插入/删除不分配内存
+ * - 推迟超时只更新 Entry 的截止 tick, 不移动链表节点(O(1)); 所在槽到期时再检查截止时间,
+ *   尚未到期的节点被挂到新的槽上, 超过一圈的超时也以同样方式多轮流转
+ * - 新的截止时间早于所在槽下一次到期(如缩短超时), 或节点本轮已到期、正等待回调时, 挪到新的槽
+ * - 超时精度为一个 tick, 回调不会早于设定的超时时间执行
+ * - 只能在所属loop线程中使用
+ */
+class TimingWheel : noncopyable
+{
+   public:
+    using Callback = InplaceFunction<void()>;
+
+    // 一个超时节点, 通常作为成员嵌入在连接等对象中; 对象析构时自动从时间轮中移除
+    class Entry : noncopyable
+    {
+       public:
+        Entry() : wheel_(nullptr), prev_(nullptr), next_(nullptr), slot_(0), deadline_(0) {}
+        ~Entry();
+
+        // 设置到期回调, 只在初始化时设置一次, 之后刷新超时不再分配内存
+        void setCallback(Callback cb) { callback_ = std::move(cb); }
+        // 是否已加入时间轮
+        bool linked() const { return wheel_ != nullptr; }
+
+       private:
+        friend class TimingWheel;
+
+        TimingWheel* wheel_;  // 所属时间轮, 未加入时为 nullptr
+        Entry* prev_;         // 槽内链表的前一个节点
+        Entry* next_;         // 槽内链表的后一个节点
+        int slot_;            // 所在的槽
+        uint64_t deadline_;   // 到期的 tick
+        Callback callback_;   // 到期回调
+    };
+
+    static const int kDefaultNumSlots = 64;
+
+    explicit TimingWheel(EventLoop* loop, double tickSeconds = 1.0, int numSlots = kDefaultNumSlots);
+    ~TimingWheel();
+
+    // 设置/刷新 entry 的超时: timeout 秒内没有再次刷新则执行其回调(回调前 entry 已被移除)
+    void schedule(Entry* entry, double timeout);
+    // 移除 entry, 未加入时什么也不做
+    void cancel(Entry* entry);
+
+    // 当前节点数量
+    size_t size() const { return size_; }
+
+   private:
+    static const int kExpiredSlot = -1;  // 本轮已到期、等待执行回调的节点所在的链表
+
+    // 时间轮前进一格
+    void onTick();
+    Entry*& head(int slot) { return slot == kExpiredSlot ? expired_ : slots_[slot]; }
+    void link(Entry* entry, int slot);
+    void unlink(Entry* entry);
+
+    EventLoop* loop_;
+    const double tickSeconds_;    // 每格的时长(秒)
+    std::vector<Entry*> slots_;   // 每个槽的链表头
+    Entry* expired_;              // 本轮到期的节点
+    uint64_t currentTick_;        // 当前 tick
+    size_t size_;                 // 节点数量
+    bool ticking_;                // 驱动时间轮的定时器是否在运行
+    TimerId tickTimer_;           // 驱动时间轮的定时器
+};
\ No newline at end of file
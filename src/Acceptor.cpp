@@ -1,6 +1,7 @@
 #include "Acceptor.h"
 
 #include <errno.h>
+#include <fcntl.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -8,6 +9,8 @@
 #include "InetAddress.h"
 #include "Logger.h"
 
+const int Acceptor::kDefaultAcceptBatch;
+
 // 创建非阻塞的socket文件描述符
 static int createNonblocking()
 {
@@ -25,11 +28,18 @@ Acceptor::Acceptor(EventLoop* loop, const InetAddress& listenAddr, bool reusepor
       // 创建socket文件描述符
       acceptSocket_(createNonblocking()),
       acceptChannel_(loop, acceptSocket_.fd()),
-      listenning_(false)
+      listenning_(false),
+      acceptBatch_(kDefaultAcceptBatch),
+      idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC)),
+      wakeups_(0),
+      accepted_(0),
+      batchFull_(0),
+      rejected_(0),
+      errors_(0)
 {
     // 设置socket选项
     acceptSocket_.setReuseAddr(true);
-    acceptSocket_.setReusePort(true);
+    acceptSocket_.setReusePort(reuseport);
     // 绑定地址
     acceptSocket_.bindAddress(listenAddr);
     // 设置新连接回调函数
@@ -42,40 +52,118 @@ Acceptor::~Acceptor()
     acceptChannel_.disableAll();
     // 将 Channel 从 Poller 中彻底移除
     acceptChannel_.remove();
+    if (idleFd_ >= 0)
+    {
+        ::close(idleFd_);
+    }
+}
+
+Acceptor::Stats Acceptor::stats() const
+{
+    Stats s;
+    s.wakeups = wakeups_.load(std::memory_order_relaxed);
+    s.accepted = accepted_.load(std::memory_order_relaxed);
+    s.batchFull = batchFull_.load(std::memory_order_relaxed);
+    s.rejected = rejected_.load(std::memory_order_relaxed);
+    s.errors = errors_.load(std::memory_order_relaxed);
+    return s;
 }
 
 void Acceptor::listen()
+{
+    if (!listenning_)
+    {
+        listenSocket();
+    }
+    // 监听socket可读事件(新连接)
+    acceptChannel_.enableReading();
+}
+
+void Acceptor::listenSocket()
 {
     listenning_ = true;
     // 监听socket
     acceptSocket_.listen();
-    // 监听socket可读事件(新连接)
-    acceptChannel_.enableReading();
 }
 
 void Acceptor::handleRead()
 {
-    InetAddress peerAddr;
-    int connfd = acceptSocket_.accept(&peerAddr);
-    if (connfd >= 0)
+    increase(wakeups_);
+    // 连接风暴时一次可读事件接受多个连接, 读到 EAGAIN 或达到 acceptBatch_ 为止
+    int n = 0;
+    bool exhausted = false;  // 本次可读事件中是否遇到过 fd 耗尽, 每次只记录一条日志
+    while (n < acceptBatch_)
     {
-        if (newConnectionCallback_)  // 回调有效
+        InetAddress peerAddr;
+        int connfd = acceptSocket_.accept(&peerAddr);
+        if (connfd >= 0)
+        {
+            ++n;
+            increase(accepted_);
+            if (newConnectionCallback_)  // 回调有效
+            {
+                // 调用 newConnectionCallback_(将新连接交给上层处理)
+                newConnectionCallback_(connfd, peerAddr);
+            }
+            else  // 回调无效
+            {
+                //理论上不应发生，表示 TcpServer 未正确设置回调
+                ::close(connfd);
+            }
+            continue;
+        }
+
+        int savedErrno = errno;
+        if (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK)
+        {
+            return;  // 队列已空
+        }
+        if (savedErrno == EINTR || savedErrno == ECONNABORTED || savedErrno == EPROTO)
         {
-            // 调用 newConnectionCallback_(将新连接交给上层处理)
-            newConnectionCallback_(connfd, peerAddr);
+            continue;  // 被信号打断, 或连接在接受前已被对端重置
         }
-        else  // 回调无效
+        if (savedErrno == EMFILE || savedErrno == ENFILE)
         {
-            //理论上不应发生，表示 TcpServer 未正确设置回调
-            ::close(connfd);
+            // 不把连接从队列中取走的话, 水平触发下监听socket会一直可读, loop 空转占满CPU
+            // 连接风暴时每个连接都会走到这里, 只在每次可读事件中记录一次, 数量见 rejected_
+            if (!exhausted)
+            {
+                exhausted = true;
+                LOG_ERROR("%s:%s:%d sockfd reached limit! \n", __FILE__, __FUNCTION__, __LINE__);
+            }
+            if (rejectWithReservedFd())
+            {
+                ++n;
+                continue;
+            }
+            increase(errors_);
+            return;
         }
+        increase(errors_);
+        LOG_ERROR("%s:%s:%d accept err:%d \n", __FILE__, __FUNCTION__, __LINE__, savedErrno);
+        return;
     }
-    else
+    increase(batchFull_);
+}
+
+bool Acceptor::rejectWithReservedFd()
+{
+    if (idleFd_ < 0)
     {
-        LOG_ERROR("%s:%s:%d accept err:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
-        if (errno == EMFILE)
+        // 上次没能重新占住预留的 fd, 再试一次
+        idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+        if (idleFd_ < 0)
         {
-            LOG_ERROR("%s:%s:%d sockfd reached limit! \n", __FILE__, __FUNCTION__, __LINE__);
+            return false;
         }
     }
+    ::close(idleFd_);
+    int connfd = ::accept4(acceptSocket_.fd(), nullptr, nullptr, SOCK_CLOEXEC);
+    if (connfd >= 0)
+    {
+        ::close(connfd);
+        increase(rejected_);
+    }
+    idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+    return true;
 }
\ No newline at end of file
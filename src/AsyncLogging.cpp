@@ -0,0 +1,231 @@
+#include "AsyncLogging.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+#include "CurrentThread.h"
+#include "LogFile.h"
+
+const size_t AsyncLogging::kMaxBufferedBuffers;
+const size_t AsyncLogging::kKeptOnOverflow;
+const size_t AsyncLogging::kMaxFreeBuffers;
+
+AsyncLogging::AsyncLogging(const std::string& basename, off_t rollSize, int flushInterval)
+    : basename_(basename),
+      rollSize_(rollSize),
+      flushInterval_(flushInterval > 0 ? flushInterval : 1),
+      running_(false),
+      thread_(std::bind(&AsyncLogging::threadFunc, this), "AsyncLogging"),
+      bufferFull_(false),
+      flushRequested_(0),
+      flushCompleted_(0),
+      droppedBuffers_(0)
+{
+}
+
+AsyncLogging::~AsyncLogging() { stop(); }
+
+void AsyncLogging::start()
+{
+    if (!basename_.empty())
+    {
+        file_.reset(new LogFile(basename_, rollSize_));
+    }
+    running_ = true;
+    thread_.start();
+}
+
+void AsyncLogging::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_)
+        {
+            return;
+        }
+        running_ = false;
+        cond_.notify_one();
+    }
+    // 后台线程在退出前会把所有缓冲区写出
+    thread_.join();
+    std::lock_guard<std::mutex> lock(mutex_);
+    flushedCond_.notify_all();
+}
+
+bool AsyncLogging::append(const char* data, size_t len)
+{
+    ThreadBuffer& tb = threadBuffer();
+    std::lock_guard<std::mutex> lock(tb.mutex);
+    // 在线程缓冲区的锁内检查: 后台线程最后一次交换缓冲区发生在 running_ 变为 false 之后,
+    // 因此这里成功追加的日志一定会被写出
+    if (!running_)
+    {
+        return false;
+    }
+    if (!tb.current || tb.current->avail() < len)
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        if (tb.current)
+        {
+            // 写满了: 挂到本线程的待写出列表, 唤醒后台线程
+            tb.full.push_back(std::move(tb.current));
+            bufferFull_ = true;
+            cond_.notify_one();
+        }
+        tb.current = takeFreeBuffer();
+    }
+    memcpy(tb.current->data + tb.current->len, data, len);
+    tb.current->len += len;
+    return true;
+}
+
+void AsyncLogging::flush()
+{
+    // 后台线程自己不能等待自己
+    if (thread_.started() && CurrentThread::tid() == thread_.tid())
+    {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!running_)
+    {
+        return;
+    }
+    uint64_t seq = ++flushRequested_;
+    cond_.notify_one();
+    flushedCond_.wait(lock, [&]() { return flushCompleted_ >= seq || !running_; });
+}
+
+AsyncLogging::ThreadBuffer& AsyncLogging::threadBuffer()
+{
+    // 线程退出时释放自己的引用, 后台线程据此回收注册表中的项
+    static thread_local ThreadBufferPtr t_buffer;
+    if (!t_buffer)
+    {
+        t_buffer = std::make_shared<ThreadBuffer>();
+        std::lock_guard<std::mutex> lock(mutex_);
+        threadBuffers_.push_back(t_buffer);
+    }
+    return *t_buffer;
+}
+
+AsyncLogging::BufferPtr AsyncLogging::takeFreeBuffer()
+{
+    if (freeBuffers_.empty())
+    {
+        return BufferPtr(new LogBuffer);
+    }
+    BufferPtr buffer = std::move(freeBuffers_.back());
+    freeBuffers_.pop_back();
+    return buffer;
+}
+
+void AsyncLogging::threadFunc()
+{
+    BufferVector buffersToWrite;
+    std::vector<ThreadBufferPtr> threads;
+    bool running = true;
+    while (running)
+    {
+        uint64_t flushSeq = 0;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (!bufferFull_ && flushRequested_ == flushCompleted_ && running_)
+            {
+                cond_.wait_for(lock, std::chrono::seconds(flushInterval_));
+            }
+            bufferFull_ = false;
+            threads = threadBuffers_;
+            flushSeq = flushRequested_;
+            running = running_;
+        }
+
+        // 按写入顺序取出各线程已写满和未写满的缓冲区, 线程下次写日志时再取空闲缓冲区
+        for (const ThreadBufferPtr& tb : threads)
+        {
+            std::lock_guard<std::mutex> lock(tb->mutex);
+            for (BufferPtr& buffer : tb->full)
+            {
+                buffersToWrite.push_back(std::move(buffer));
+            }
+            tb->full.clear();
+            if (tb->current && tb->current->len > 0)
+            {
+                buffersToWrite.push_back(std::move(tb->current));
+            }
+        }
+        threads.clear();
+
+        writeBuffers(buffersToWrite);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (BufferPtr& buffer : buffersToWrite)
+        {
+            if (freeBuffers_.size() < kMaxFreeBuffers)
+            {
+                buffer->len = 0;
+                freeBuffers_.push_back(std::move(buffer));
+            }
+        }
+        buffersToWrite.clear();
+        // 回收已退出且没有剩余日志的线程
+        for (size_t i = 0; i < threadBuffers_.size();)
+        {
+            ThreadBufferPtr& tb = threadBuffers_[i];
+            if (tb.use_count() == 1 && tb->full.empty() && (!tb->current || tb->current->len == 0))
+            {
+                tb.swap(threadBuffers_.back());
+                threadBuffers_.pop_back();
+            }
+            else
+            {
+                ++i;
+            }
+        }
+        flushCompleted_ = flushSeq;
+        flushedCond_.notify_all();
+    }
+}
+
+void AsyncLogging::writeBuffers(BufferVector& buffers)
+{
+    if (buffers.size() > kMaxBufferedBuffers)
+    {
+        // 日志产生得比写出得快: 只保留最早的几块, 其余丢弃
+        size_t dropped = buffers.size() - kKeptOnOverflow;
+        droppedBuffers_ += dropped;
+        char note[128];
+        int len = snprintf(note, sizeof note,
+                           "Dropped %lu log buffers at once, %lu in total, logs are produced too fast\n",
+                           (unsigned long)dropped, (unsigned long)droppedBuffers_);
+        buffers.resize(kKeptOnOverflow);
+        if (file_)
+        {
+            file_->append(note, len);
+        }
+        else
+        {
+            fwrite(note, 1, len, stdout);
+        }
+    }
+    for (const BufferPtr& buffer : buffers)
+    {
+        if (file_)
+        {
+            file_->append(buffer->data, buffer->len);
+        }
+        else
+        {
+            fwrite(buffer->data, 1, buffer->len, stdout);
+        }
+    }
+    if (file_)
+    {
+        file_->flush();
+    }
+    else
+    {
+        fflush(stdout);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,270 @@
+#include "BinaryLogging.h"
+
+#include <chrono>
+#include <stdio.h>
+
+#include "CurrentThread.h"
+#include "LogFile.h"
+
+const char BinaryLogging::kMagic[8] = {'M', 'U', 'D', 'U', 'O', 'B', 'L', '1'};
+const size_t BinaryLogging::kMaxStringLen;
+const int BinaryLogging::kDrainIntervalMs;
+
+__thread BinaryLogRing* t_binaryLogRing = nullptr;
+
+namespace
+{
+// 调用点注册表, 进程内全局, 与后端实例无关
+std::mutex g_siteMutex;
+std::vector<const BinaryLogSite*> g_sites;  // 下标 + 1 即调用点 id
+
+// 当前开启的后端
+std::atomic<BinaryLogging*> g_binaryLogging(nullptr);
+
+size_t roundUpPowerOfTwo(size_t n)
+{
+    size_t capacity = 4096;
+    while (capacity < n)
+    {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+template <typename T>
+void appendValue(std::string& out, T value)
+{
+    out.append(reinterpret_cast<const char*>(&value), sizeof value);
+}
+
+// 把调用点编码为 'S' 记录
+void appendSite(std::string& out, uint32_t id, const BinaryLogSite* site)
+{
+    uint16_t formatLen = static_cast<uint16_t>(strnlen(site->format, 65535));
+    uint16_t fileLen = static_cast<uint16_t>(strnlen(site->file, 65535));
+    out.push_back(static_cast<char>(BinaryLogging::kSiteRecord));
+    appendValue(out, id);
+    appendValue(out, static_cast<uint8_t>(site->level));
+    appendValue(out, static_cast<uint32_t>(site->line));
+    appendValue(out, formatLen);
+    out.append(site->format, formatLen);
+    appendValue(out, fileLen);
+    out.append(site->file, fileLen);
+}
+}  // namespace
+
+BinaryLogRing::BinaryLogRing(size_t capacity, int tid)
+    : buffer_(new char[roundUpPowerOfTwo(capacity)]),
+      capacity_(roundUpPowerOfTwo(capacity)),
+      mask_(capacity_ - 1),
+      tid_(tid),
+      tail_(0),
+      pendingTail_(0),
+      headCache_(0),
+      dropped_(0),
+      head_(0),
+      reportedDropped_(0)
+{
+}
+
+BinaryLogRing::~BinaryLogRing() { delete[] buffer_; }
+
+BinaryLogging::BinaryLogging(const std::string& basename, size_t ringBytes, off_t rollSize)
+    : basename_(basename),
+      rollSize_(rollSize),
+      ringBytes_(ringBytes),
+      sitesWritten_(0),
+      running_(false),
+      thread_(std::bind(&BinaryLogging::threadFunc, this), "BinaryLogging"),
+      flushRequested_(0),
+      flushCompleted_(0)
+{
+}
+
+BinaryLogging::~BinaryLogging() { stop(); }
+
+void BinaryLogging::start()
+{
+    file_.reset(new LogFile(basename_, rollSize_,
+                            std::bind(&BinaryLogging::writeFileHeader, this, std::placeholders::_1)));
+    running_ = true;
+    g_binaryLogging.store(this, std::memory_order_release);
+    thread_.start();
+}
+
+void BinaryLogging::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_)
+        {
+            return;
+        }
+        running_ = false;
+        cond_.notify_one();
+    }
+    // 后台线程退出前会再搬运一次; 停止过程中仍在写入的少量记录可能丢失
+    thread_.join();
+    g_binaryLogging.store(nullptr, std::memory_order_release);
+    std::lock_guard<std::mutex> lock(mutex_);
+    flushedCond_.notify_all();
+}
+
+void BinaryLogging::flush()
+{
+    if (thread_.started() && CurrentThread::tid() == thread_.tid())
+    {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!running_)
+    {
+        return;
+    }
+    uint64_t seq = ++flushRequested_;
+    cond_.notify_one();
+    flushedCond_.wait(lock, [&]() { return flushCompleted_ >= seq || !running_; });
+}
+
+uint32_t BinaryLogging::registerSite(BinaryLogSite* site)
+{
+    std::lock_guard<std::mutex> lock(g_siteMutex);
+    uint32_t id = site->id.load(std::memory_order_relaxed);
+    if (id == 0)
+    {
+        g_sites.push_back(site);
+        id = static_cast<uint32_t>(g_sites.size());
+        site->id.store(id, std::memory_order_release);
+    }
+    return id;
+}
+
+BinaryLogRing* BinaryLogging::createThreadRing()
+{
+    BinaryLogging* logging = g_binaryLogging.load(std::memory_order_acquire);
+    if (logging == nullptr)
+    {
+        return nullptr;
+    }
+    // 线程退出时释放自己的引用, 后台线程据此回收队列
+    static thread_local std::shared_ptr<BinaryLogRing> t_ringHolder;
+    t_ringHolder = std::make_shared<BinaryLogRing>(logging->ringBytes_, CurrentThread::tid());
+    {
+        std::lock_guard<std::mutex> lock(logging->mutex_);
+        logging->rings_.push_back(t_ringHolder);
+    }
+    t_binaryLogRing = t_ringHolder.get();
+    return t_binaryLogRing;
+}
+
+void BinaryLogging::threadFunc()
+{
+    bool running = true;
+    while (running)
+    {
+        uint64_t flushSeq = 0;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (flushRequested_ == flushCompleted_ && running_)
+            {
+                cond_.wait_for(lock, std::chrono::milliseconds(kDrainIntervalMs));
+            }
+            flushSeq = flushRequested_;
+            running = running_;
+        }
+
+        drain();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        flushCompleted_ = flushSeq;
+        flushedCond_.notify_all();
+    }
+}
+
+void BinaryLogging::drain()
+{
+    std::vector<std::shared_ptr<BinaryLogRing>> rings;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        rings = rings_;
+    }
+
+    // 先把记录搬到写出缓冲区, 再写调用点表: 记录写入队列之前它的调用点一定已经注册
+    staging_.clear();
+    for (const std::shared_ptr<BinaryLogRing>& ring : rings)
+    {
+        uint32_t tid = static_cast<uint32_t>(ring->tid());
+        ring->consume(
+            [&](const BinaryLogRing::RecordHeader* header)
+            {
+                staging_.push_back(static_cast<char>(kLogRecord));
+                appendValue(staging_, tid);
+                appendValue(staging_, header->siteId);
+                appendValue(staging_, header->micros);
+                appendValue(staging_, header->argsLen);
+                staging_.append(reinterpret_cast<const char*>(header + 1), header->argsLen);
+            });
+        uint64_t dropped = ring->takeDropped();
+        if (dropped > 0)
+        {
+            staging_.push_back(static_cast<char>(kDropRecord));
+            appendValue(staging_, tid);
+            appendValue(staging_, dropped);
+        }
+    }
+    rings.clear();
+
+    writeNewSites();
+    if (!staging_.empty())
+    {
+        file_->append(staging_.data(), staging_.size());
+    }
+    file_->flush();
+
+    // 回收已退出且队列已空的线程
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < rings_.size();)
+    {
+        if (rings_[i].use_count() == 1 && rings_[i]->empty())
+        {
+            rings_[i].swap(rings_.back());
+            rings_.pop_back();
+        }
+        else
+        {
+            ++i;
+        }
+    }
+}
+
+void BinaryLogging::writeNewSites()
+{
+    std::string out;
+    {
+        std::lock_guard<std::mutex> lock(g_siteMutex);
+        for (size_t i = sitesWritten_; i < g_sites.size(); ++i)
+        {
+            appendSite(out, static_cast<uint32_t>(i + 1), g_sites[i]);
+        }
+        sitesWritten_ = g_sites.size();
+    }
+    if (!out.empty())
+    {
+        file_->append(out.data(), out.size());
+    }
+}
+
+void BinaryLogging::writeFileHeader(LogFile* file)
+{
+    // 每个文件都带完整的调用点表, 可以单独解码
+    std::string out(kMagic, sizeof kMagic);
+    {
+        std::lock_guard<std::mutex> lock(g_siteMutex);
+        for (size_t i = 0; i < g_sites.size(); ++i)
+        {
+            appendSite(out, static_cast<uint32_t>(i + 1), g_sites[i]);
+        }
+        sitesWritten_ = g_sites.size();
+    }
+    file->append(out.data(), out.size());
+}
\ No newline at end of file
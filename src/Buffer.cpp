@@ -1,11 +1,141 @@
 #include "Buffer.h"
 
 #include <errno.h>
+#include <string.h>
 #include <sys/uio.h>
 #include <unistd.h>
 
+#include "BufferPool.h"
+
+const size_t Buffer::kCheapPrepend;
+const size_t Buffer::kInitialSize;
+const size_t Buffer::kSegmentSize;
+const int Buffer::kMaxIovecs;
+
+// 尚未分配存储区时使用的占位区: 只有预留区大小, 可写空间为0,
+// 使 peek()/beginWrite() 在分配前也返回合法地址, 首次写入时才真正分配
+static char kEmptyStorage[Buffer::kCheapPrepend] = {0};
+
+Buffer::Buffer(size_t initialSize, Mode mode)
+    : mode_(mode),
+      buffer_(kEmptyStorage),
+      capacity_(kCheapPrepend),
+      initialSize_(initialSize),
+      readerIndex_(kCheapPrepend),  // 读索引指向预留区之后
+      writerIndex_(kCheapPrepend),  // 写索引初始时与读索引相同
+      segmentedReadable_(0)
+{
+}
+
+Buffer::~Buffer()
+{
+    releaseStorage();
+    releaseSegments();
+}
+
+Buffer::Buffer(const Buffer& rhs)
+    : mode_(rhs.mode_),
+      buffer_(kEmptyStorage),
+      capacity_(kCheapPrepend),
+      initialSize_(rhs.initialSize_),
+      readerIndex_(kCheapPrepend),
+      writerIndex_(kCheapPrepend),
+      segmentedReadable_(0)
+{
+    if (rhs.buffer_ != kEmptyStorage)
+    {
+        capacity_ = rhs.capacity_;
+        readerIndex_ = rhs.readerIndex_;
+        writerIndex_ = rhs.writerIndex_;
+        buffer_ = BufferPool::allocateBlock(capacity_);
+        ::memcpy(buffer_ + readerIndex_, rhs.buffer_ + readerIndex_, writerIndex_ - readerIndex_);
+    }
+    // 分段模式下逐块拷贝可读数据
+    for (const Segment& seg : rhs.segments_)
+    {
+        segmentedAppend(seg.peek(), seg.readableBytes());
+    }
+}
+
+Buffer& Buffer::operator=(const Buffer& rhs)
+{
+    if (this != &rhs)
+    {
+        Buffer tmp(rhs);
+        swap(tmp);
+    }
+    return *this;
+}
+
+Buffer::Buffer(Buffer&& rhs) noexcept
+    : mode_(rhs.mode_),
+      buffer_(kEmptyStorage),
+      capacity_(kCheapPrepend),
+      initialSize_(rhs.initialSize_),
+      readerIndex_(kCheapPrepend),
+      writerIndex_(kCheapPrepend),
+      segmentedReadable_(0)
+{
+    swap(rhs);
+}
+
+Buffer& Buffer::operator=(Buffer&& rhs) noexcept
+{
+    if (this != &rhs)
+    {
+        Buffer tmp(std::move(rhs));
+        swap(tmp);
+    }
+    return *this;
+}
+
+void Buffer::swap(Buffer& rhs) noexcept
+{
+    std::swap(mode_, rhs.mode_);
+    std::swap(buffer_, rhs.buffer_);
+    std::swap(capacity_, rhs.capacity_);
+    std::swap(initialSize_, rhs.initialSize_);
+    std::swap(readerIndex_, rhs.readerIndex_);
+    std::swap(writerIndex_, rhs.writerIndex_);
+    segments_.swap(rhs.segments_);
+    std::swap(segmentedReadable_, rhs.segmentedReadable_);
+}
+
+std::string Buffer::retrieveAsString(size_t len)
+{
+    len = std::min(len, readableBytes());
+    if (!segmented())
+    {
+        std::string result(peek(), len);
+        retrieve(len);
+        return result;
+    }
+
+    // 分段模式: 逐块拷贝, 避免先合并再拷贝的两次复制
+    std::string result;
+    result.reserve(len);
+    size_t left = len;
+    for (const Segment& seg : segments_)
+    {
+        if (left == 0)
+        {
+            break;
+        }
+        size_t n = std::min(left, seg.readableBytes());
+        result.append(seg.peek(), n);
+        left -= n;
+    }
+    retrieve(len);
+    return result;
+}
+
 ssize_t Buffer::readFd(int fd, int* saveErrno)
 {
+    if (segmented())
+    {
+        return segmentedReadFd(fd, saveErrno);
+    }
+
     // 在栈上定义额外的缓冲区，大小为64KB
     char extrabuf[65536] = {0};
     // 设置iovec结构体数组，第一个元素指向缓冲区中可读数据的起始位置，第二个元素指向额外的栈上缓冲区
@@ -33,7 +163,7 @@ ssize_t Buffer::readFd(int fd, int* saveErrno)
     }
     else  // 数据填满主缓冲区并溢出到栈缓冲区
     {
-        writerIndex_ = buffer_.size();   // 将写索引移到末尾
+        writerIndex_ = capacity_;        // 将写索引移到末尾
         append(extrabuf, n - writable);  // 将栈缓冲区数据追加到主缓冲区
     }
 
@@ -42,6 +172,11 @@ ssize_t Buffer::readFd(int fd, int* saveErrno)
 
 ssize_t Buffer::writeFd(int fd, int* saveErrno)
 {
+    if (segmented())
+    {
+        return segmentedWriteFd(fd, saveErrno);
+    }
+
     // 从可写索引(开始与可读索引相同)写入数据到fd中
     ssize_t n = ::write(fd, peek(), readableBytes());
     if (n < 0)
@@ -49,4 +184,252 @@ ssize_t Buffer::writeFd(int fd, int* saveErrno)
         *saveErrno = errno;  // 写入失败，设置 errno
     }
     return n;
-}
\ No newline at end of file
+}
+
+size_t Buffer::capacity() const
+{
+    if (segmented())
+    {
+        size_t total = 0;
+        for (const Segment& seg : segments_)
+        {
+            total += seg.capacity;
+        }
+        return total;
+    }
+    return buffer_ == kEmptyStorage ? 0 : capacity_;
+}
+
+void Buffer::shrink(size_t reserve)
+{
+    const size_t readable = readableBytes();
+    if (segmented())
+    {
+        if (readable == 0)
+        {
+            releaseSegments();
+        }
+        else if (segments_.back().readableBytes() == 0)
+        {
+            // 归还 readFd 预留的空尾块
+            BufferPool::deallocateBlock(segments_.back().data, segments_.back().capacity);
+            segments_.pop_back();
+        }
+        return;
+    }
+
+    if (readable == 0 && reserve == 0)
+    {
+        // 没有数据: 整块归还内存池, 回到未分配状态
+        releaseStorage();
+        return;
+    }
+    const size_t newCapacity = BufferPool::roundUp(kCheapPrepend + readable + reserve);
+    if (buffer_ != kEmptyStorage && newCapacity < capacity_)
+    {
+        char* newBuffer = BufferPool::allocateBlock(newCapacity);
+        ::memcpy(newBuffer + kCheapPrepend, buffer_ + readerIndex_, readable);
+        BufferPool::deallocateBlock(buffer_, capacity_);
+        buffer_ = newBuffer;
+        capacity_ = newCapacity;
+        readerIndex_ = kCheapPrepend;
+        writerIndex_ = kCheapPrepend + readable;
+    }
+}
+
+void Buffer::grow(size_t capacity)
+{
+    // 首次分配时至少分配构造时指定的初始大小
+    if (buffer_ == kEmptyStorage)
+    {
+        capacity = std::max(capacity, kCheapPrepend + initialSize_);
+    }
+    // 从内存池取一块更大的存储区, 只搬移可读数据, 预留区重新从 kCheapPrepend 开始
+    const size_t readable = readableBytes();
+    size_t newCapacity = BufferPool::roundUp(std::max(capacity, kCheapPrepend + readable));
+    char* newBuffer = BufferPool::allocateBlock(newCapacity);
+    if (buffer_ != kEmptyStorage)
+    {
+        ::memcpy(newBuffer + kCheapPrepend, buffer_ + readerIndex_, readable);
+        BufferPool::deallocateBlock(buffer_, capacity_);
+    }
+    buffer_ = newBuffer;
+    capacity_ = newCapacity;
+    readerIndex_ = kCheapPrepend;
+    writerIndex_ = kCheapPrepend + readable;
+}
+
+const char* Buffer::segmentedPeek() const
+{
+    if (segmentedReadable_ == 0)
+    {
+        return kEmptyStorage;
+    }
+    const Segment& front = segments_.front();
+    if (front.readableBytes() == segmentedReadable_)
+    {
+        return front.peek();  // 所有可读数据都在首块中, 无需合并
+    }
+
+    // 可读数据跨越多个块: 合并到一个新块中(调用方需要连续视图时才付出这次拷贝)
+    Segment merged;
+    merged.capacity =
+        BufferPool::roundUp(std::max(kCheapPrepend + segmentedReadable_, kSegmentSize));
+    merged.data = BufferPool::allocateBlock(merged.capacity);
+    merged.readerIndex = kCheapPrepend;
+    merged.writerIndex = kCheapPrepend;
+    for (const Segment& seg : segments_)
+    {
+        ::memcpy(merged.beginWrite(), seg.peek(), seg.readableBytes());
+        merged.writerIndex += seg.readableBytes();
+        BufferPool::deallocateBlock(seg.data, seg.capacity);
+    }
+    segments_.clear();
+    segments_.push_back(merged);
+    return segments_.front().peek();
+}
+
+void Buffer::segmentedRetrieve(size_t len)
+{
+    segmentedReadable_ -= len;
+    while (len > 0)
+    {
+        Segment& front = segments_.front();
+        size_t n = std::min(len, front.readableBytes());
+        front.readerIndex += n;
+        len -= n;
+        // 首块已读空且后面还有块: 归还首块
+        if (front.readableBytes() == 0 && segments_.size() > 1)
+        {
+            BufferPool::deallocateBlock(front.data, front.capacity);
+            segments_.pop_front();
+        }
+    }
+}
+
+void Buffer::segmentedAppend(const char* data, size_t len)
+{
+    while (len > 0)
+    {
+        if (segments_.empty() || segments_.back().writableBytes() == 0)
+        {
+            pushSegment(kSegmentSize);
+        }
+        Segment& back = segments_.back();
+        size_t n = std::min(len, back.writableBytes());
+        ::memcpy(back.beginWrite(), data, n);
+        back.writerIndex += n;
+        segmentedReadable_ += n;
+        data += n;
+        len -= n;
+    }
+}
+
+ssize_t Buffer::segmentedReadFd(int fd, int* saveErrno)
+{
+    // 尾块剩余空间不足一个块时, 预先挂上一个新块, 由 readv 直接填充,
+    // 省去连续模式下从栈缓冲区再拷贝一次的开销; 未用到的新块保留给下次读取
+    if (writableBytes() < kSegmentSize)
+    {
+        pushSegment(kSegmentSize);
+    }
+
+    struct iovec vec[2];
+    int iovcnt = 0;
+    // 新块之前那个块的剩余空间也一并交给 readv(仅当新块中还没有数据时, 以保证数据顺序)
+    const size_t n1 = (segments_.size() > 1 && segments_.back().readableBytes() == 0)
+                          ? segments_[segments_.size() - 2].writableBytes()
+                          : 0;
+    if (n1 > 0)
+    {
+        Segment& prev = segments_[segments_.size() - 2];
+        vec[iovcnt].iov_base = prev.beginWrite();
+        vec[iovcnt].iov_len = n1;
+        ++iovcnt;
+    }
+    Segment& back = segments_.back();
+    vec[iovcnt].iov_base = back.beginWrite();
+    vec[iovcnt].iov_len = back.writableBytes();
+    ++iovcnt;
+
+    const ssize_t n = ::readv(fd, vec, iovcnt);
+    if (n < 0)
+    {
+        *saveErrno = errno;
+        return n;
+    }
+
+    size_t left = static_cast<size_t>(n);
+    if (n1 > 0)
+    {
+        size_t m = std::min(left, n1);
+        segments_[segments_.size() - 2].writerIndex += m;
+        left -= m;
+    }
+    segments_.back().writerIndex += left;
+    segmentedReadable_ += n;
+    return n;
+}
+
+ssize_t Buffer::segmentedWriteFd(int fd, int* saveErrno)
+{
+    // 把多个块的可读数据组装成 iovec 数组, 一次 writev 提交
+    struct iovec vec[kMaxIovecs];
+    int iovcnt = 0;
+    for (const Segment& seg : segments_)
+    {
+        if (iovcnt == kMaxIovecs)
+        {
+            break;
+        }
+        if (seg.readableBytes() > 0)
+        {
+            vec[iovcnt].iov_base = const_cast<char*>(seg.peek());
+            vec[iovcnt].iov_len = seg.readableBytes();
+            ++iovcnt;
+        }
+    }
+    if (iovcnt == 0)
+    {
+        return 0;
+    }
+
+    ssize_t n = ::writev(fd, vec, iovcnt);
+    if (n < 0)
+    {
+        *saveErrno = errno;  // 写入失败，设置 errno
+    }
+    return n;
+}
+
+Buffer::Segment& Buffer::pushSegment(size_t capacity)
+{
+    Segment seg;
+    seg.capacity = BufferPool::roundUp(capacity);
+    seg.data = BufferPool::allocateBlock(seg.capacity);
+    seg.readerIndex = 0;
+    seg.writerIndex = 0;
+    segments_.push_back(seg);
+    return segments_.back();
+}
+
+void Buffer::releaseStorage()
+{
+    if (buffer_ != kEmptyStorage)
+    {
+        BufferPool::deallocateBlock(buffer_, capacity_);
+        buffer_ = kEmptyStorage;
+        capacity_ = kCheapPrepend;
+    }
+    readerIndex_ = writerIndex_ = kCheapPrepend;
+}
+
+void Buffer::releaseSegments()
+{
+    for (const Segment& seg : segments_)
+    {
+        BufferPool::deallocateBlock(seg.data, seg.capacity);
+    }
+    segments_.clear();
+    segmentedReadable_ = 0;
+}
@@ -0,0 +1,164 @@
+#include "BufferPool.h"
+
+#include <stdlib.h>
+
+#include "Logger.h"
+
+const size_t BufferPool::kMinBlockSize;
+const size_t BufferPool::kMaxBlockSize;
+const int BufferPool::kNumClasses;
+const size_t BufferPool::kDefaultMaxBytesHeld;
+
+// 当前线程所属 EventLoop 的内存池
+__thread BufferPool* t_bufferPool = nullptr;
+
+BufferPool::BufferPool()
+    : maxBytesHeld_(kDefaultMaxBytesHeld),
+      hits_(0),
+      misses_(0),
+      releases_(0),
+      bytesHeld_(0),
+      blocksHeld_(0)
+{
+    for (int i = 0; i < kNumClasses; ++i)
+    {
+        freeLists_[i] = nullptr;
+    }
+}
+
+BufferPool::~BufferPool()
+{
+    // 释放所有缓存的空闲块
+    for (int i = 0; i < kNumClasses; ++i)
+    {
+        FreeBlock* block = freeLists_[i];
+        while (block)
+        {
+            FreeBlock* next = block->next;
+            ::free(block);
+            block = next;
+        }
+        freeLists_[i] = nullptr;
+    }
+}
+
+char* BufferPool::allocate(size_t capacity)
+{
+    int idx = classIndex(capacity);
+    if (idx >= 0 && freeLists_[idx])
+    {
+        // 命中: 从空闲链表头部取出一个块
+        FreeBlock* block = freeLists_[idx];
+        freeLists_[idx] = block->next;
+        bytesHeld_.store(bytesHeld_.load(std::memory_order_relaxed) - capacity,
+                         std::memory_order_relaxed);
+        blocksHeld_.store(blocksHeld_.load(std::memory_order_relaxed) - 1,
+                          std::memory_order_relaxed);
+        increase(hits_);
+        return reinterpret_cast<char*>(block);
+    }
+
+    // 未命中: 回落到 malloc
+    increase(misses_);
+    char* block = static_cast<char*>(::malloc(capacity));
+    if (block == nullptr)
+    {
+        LOG_FATAL("BufferPool::allocate %lu bytes failed \n", capacity);
+    }
+    return block;
+}
+
+void BufferPool::deallocate(char* block, size_t capacity)
+{
+    increase(releases_);
+    int idx = classIndex(capacity);
+    size_t held = bytesHeld_.load(std::memory_order_relaxed);
+    if (idx < 0 || held + capacity > maxBytesHeld_)
+    {
+        // 超大块或缓存已满: 直接归还给系统
+        ::free(block);
+        return;
+    }
+
+    FreeBlock* node = reinterpret_cast<FreeBlock*>(block);
+    node->next = freeLists_[idx];
+    freeLists_[idx] = node;
+    bytesHeld_.store(held + capacity, std::memory_order_relaxed);
+    blocksHeld_.store(blocksHeld_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+BufferPool::Stats BufferPool::stats() const
+{
+    Stats s;
+    s.hits = hits_.load(std::memory_order_relaxed);
+    s.misses = misses_.load(std::memory_order_relaxed);
+    s.releases = releases_.load(std::memory_order_relaxed);
+    s.bytesHeld = bytesHeld_.load(std::memory_order_relaxed);
+    s.blocksHeld = blocksHeld_.load(std::memory_order_relaxed);
+    return s;
+}
+
+size_t BufferPool::roundUp(size_t size)
+{
+    if (size > kMaxBlockSize)
+    {
+        return size;
+    }
+    size_t capacity = kMinBlockSize;
+    while (capacity < size)
+    {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+int BufferPool::classIndex(size_t capacity)
+{
+    if (capacity > kMaxBlockSize)
+    {
+        return -1;
+    }
+    int idx = 0;
+    size_t size = kMinBlockSize;
+    while (size < capacity)
+    {
+        size <<= 1;
+        ++idx;
+    }
+    // 只接受恰好等于等级大小的块
+    return size == capacity ? idx : -1;
+}
+
+BufferPool* BufferPool::current() { return t_bufferPool; }
+
+void BufferPool::setCurrent(BufferPool* pool) { t_bufferPool = pool; }
+
+char* BufferPool::allocateBlock(size_t capacity)
+{
+    if (t_bufferPool)
+    {
+        return t_bufferPool->allocate(capacity);
+    }
+    char* block = static_cast<char*>(::malloc(capacity));
+    if (block == nullptr)
+    {
+        LOG_FATAL("BufferPool::allocateBlock %lu bytes failed \n", capacity);
+    }
+    return block;
+}
+
+void BufferPool::deallocateBlock(char* block, size_t capacity)
+{
+    if (block == nullptr)
+    {
+        return;
+    }
+    if (t_bufferPool)
+    {
+        t_bufferPool->deallocate(block, capacity);
+    }
+    else
+    {
+        ::free(block);
+    }
+}
@@ -8,9 +8,10 @@
 const int Channel::kNoneEvent = 0;
 const int Channel::kReadEvent = EPOLLIN | EPOLLPRI;
 const int Channel::kWriteEvent = EPOLLOUT;
+const int Channel::kEdgeTriggered = EPOLLET;
 
 Channel::Channel(EventLoop* loop, int fd)
-    : loop_(loop), fd_(fd), events_(0), revents_(0), index_(-1), tied_(false)
+    : loop_(loop), fd_(fd), events_(0), revents_(0), edgeTriggered_(false), tied_(false)
 {
 }
 
@@ -53,7 +54,7 @@ void Channel::handleEvent(Timestamp receiveTime)
 // 根据poller通知的channel发生的具体事件， 由channel负责调用具体的回调操作
 void Channel::handleEventWithGuard(Timestamp receiveTime)
 {
-    LOG_INFO("channel handleEvent revents:%d\n", revents_);
+    LOG_DEBUG("channel handleEvent revents:%d\n", revents_);
 
     if ((revents_ & EPOLLHUP) && !(revents_ & EPOLLIN))
     {
@@ -65,7 +66,9 @@ void Channel::handleEventWithGuard(Timestamp receiveTime)
 
     if (revents_ & EPOLLERR)
     {
-        if (errorCallback_)
+        // 先读取错误队列中的通知; 若 EPOLLERR 完全由通知引起, 则不是真正的socket错误
+        bool onlyNotifications = errorQueueCallback_ && errorQueueCallback_();
+        if (errorCallback_ && !onlyNotifications)
         {
             errorCallback_();
         }
@@ -79,7 +82,8 @@ void Channel::handleEventWithGuard(Timestamp receiveTime)
         }
     }
 
-    if (revents_ & EPOLLOUT)
+    // 边缘触发模式下可写事件一直处于注册状态, 只有上层确实在等待可写时才分发
+    if ((revents_ & EPOLLOUT) && (!edgeTriggered_ || isWriting()))
     {
         if (writeCallback_)
         {
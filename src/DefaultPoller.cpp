@@ -1,6 +1,8 @@
 #include <stdlib.h>
 #include "Poller.h"
 #include "EPollPoller.h"
+#include "IoUringPoller.h"
+#include "Logger.h"
 
 Poller *Poller::newDefaultPoller(EventLoop *loop)
 {
@@ -8,6 +10,17 @@ Poller *Poller::newDefaultPoller(EventLoop *loop)
     {
         return nullptr; // 生成poll实例
     }
+    else if (::getenv("MUDUO_USE_IOURING"))
+    {
+        // 生成io_uring实例, 内核不支持时回退到epoll
+        Poller *poller = IoUringPoller::create(loop);
+        if (poller)
+        {
+            return poller;
+        }
+        LOG_ERROR("io_uring is not available, falling back to epoll \n");
+        return new EPollPoller(loop);
+    }
     else
     {
         return new EPollPoller(loop); // 生成epoll实例
@@ -5,13 +5,6 @@
 #include "Logger.h"
 #include "Channel.h"
 
-// channel未添加到poller中(初始状态)
-const int kNew = -1; // channel的成员index_ = -1
-// channel已添加到poller中(epoll已监听)
-const int kAdded = 1;
-// channel从poller中删除(逻辑删除，epoll可能已移除监听)
-const int kDeleted = 2;
-
 EPollPoller::EPollPoller(EventLoop *loop)
     : Poller(loop),
       epollfd_(::epoll_create1(EPOLL_CLOEXEC)),
@@ -32,8 +25,11 @@ EPollPoller::~EPollPoller()
 
 Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
 {
-    // 在高并发场景下，用LOG_DEBUG输出日志更为合理
-    LOG_INFO("func=%s => fd total count:%lu \n", __FUNCTION__, channels_.size());
+    // 每轮循环都会执行, 只作为调试日志; 忙轮询时的 0 超时 poll 调用非常频繁, 不记录
+    if (timeoutMs != 0)
+    {
+        LOG_DEBUG("func=%s => fd total count:%lu \n", __FUNCTION__, numChannels());
+    }
     // 调用 epoll_wait 等待事件发生
     int numEvents = ::epoll_wait(epollfd_, &*events_.begin(), static_cast<int>(events_.size()), timeoutMs);
     // 立刻保存 errno，防止后续操作（如日志、时间获取）修改它
@@ -43,7 +39,7 @@ Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
 
     if (numEvents > 0) // 有事件发生
     {
-        LOG_INFO("%d events happened \n", numEvents);
+        LOG_DEBUG("%d events happened \n", numEvents);
         // 处理就绪事件，填充活跃事件列表
         fillActiveChannels(numEvents, activeChannels);
         // 如果活跃事件列表已满，则扩容
@@ -74,39 +70,38 @@ Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
 // 更新 Channel 在 epoll 中的监听状态
 void EPollPoller::updateChannel(Channel *channel)
 {
-    const int index = channel->index();
-    LOG_INFO("func=%s => fd=%d events=%d index=%d\n", __FUNCTION__, channel->fd(), channel->events(), index);
+    ChannelSlot *slot = findSlot(channel);
+    LOG_DEBUG("func=%s => fd=%d events=%d state=%d\n", __FUNCTION__, channel->fd(), channel->events(),
+              slot ? slot->state : kNew);
 
-    if (index == kNew || index == kDeleted)
+    if (slot == nullptr || slot->state == kDeleted)
     {
         // 情况1: Channel 是全新的(kNew) 或 之前已被逻辑删除(kDeleted)
         // 这两种情况都需要将 Channel 添加到 epoll 监听中
-        if (index == kNew)
+        if (slot == nullptr)
         {
-            // 如果是全新的，将其添加到 Poller 内部的 channels_ map 中
-            int fd = channel->fd();
-            channels_[fd] = channel;
+            // 如果是全新的，让它占用 fd 对应的表项
+            slot = &insertChannel(channel);
         }
         // 将 Channel 状态标记为已添加
-        channel->set_index(kAdded);
+        slot->state = kAdded;
         // 调用内部 update 函数，执行 epoll_ctl(ADD) 操作
-        update(EPOLL_CTL_ADD, channel);
+        update(EPOLL_CTL_ADD, channel, slot->generation);
     }
     else
     {
         // 情况2: Channel 已经是 kAdded 状态，表示已在 epoll 中监听
-        int fd = channel->fd();
         if (channel->isNoneEvent()) // 检查 Channel 是否已不再关心任何事件
         {
             // 如果不关心任何事件，则从 epoll 中移除监听
-            update(EPOLL_CTL_DEL, channel);
+            update(EPOLL_CTL_DEL, channel, slot->generation);
             // 将 Channel 状态标记为已删除 (逻辑删除)
-            channel->set_index(kDeleted);
+            slot->state = kDeleted;
         }
         else
         {
             // 如果仍然关心事件 (可能事件类型已改变)，则修改 epoll 中的监听设置
-            update(EPOLL_CTL_MOD, channel);
+            update(EPOLL_CTL_MOD, channel, slot->generation);
         }
     }
 }
@@ -115,20 +110,20 @@ void EPollPoller::updateChannel(Channel *channel)
 void EPollPoller::removeChannel(Channel *channel)
 {
     int fd = channel->fd();
-    // 从 Poller 的 channels_ map 中移除 fd->Channel* 的映射
-    channels_.erase(fd);
-
-    LOG_INFO("func=%s => fd=%d\n", __FUNCTION__, fd);
+    LOG_DEBUG("func=%s => fd=%d\n", __FUNCTION__, fd);
 
-    // 获取 Channel 当前状态
-    int index = channel->index();
-    if (index == kAdded)
+    ChannelSlot *slot = findSlot(channel);
+    if (slot == nullptr)
+    {
+        return;
+    }
+    if (slot->state == kAdded)
     {
         // 如果 Channel 当前仍在 epoll 中监听 (kAdded)，则需要调用 epoll_ctl 将其移除
-        update(EPOLL_CTL_DEL, channel);
+        update(EPOLL_CTL_DEL, channel, slot->generation);
     }
-    // 将 Channel 状态设置为 kDeleted (表示已从Poller中删除)
-    channel->set_index(kDeleted);
+    // 清空 fd 对应的表项, Channel 回到 kNew 状态
+    eraseChannel(fd);
 }
 
 // 遍历 epoll_wait 返回的就绪事件，填充 activeChannels 列表
@@ -136,8 +131,13 @@ void EPollPoller::fillActiveChannels(int numEvents, ChannelList *activeChannels)
 {
     for (int i = 0; i < numEvents; ++i)
     {
-        // 关键: 直接从 epoll_event.data.ptr 中高效获取关联的 Channel 指针
-        Channel *channel = static_cast<Channel *>(events_[i].data.ptr);
+        // 从 epoll_event.data.u64 中取出 fd 和代数, 在表中找到关联的 Channel
+        uint64_t data = events_[i].data.u64;
+        Channel *channel = findChannel(static_cast<int>(data & 0xffffffff), static_cast<uint32_t>(data >> 32));
+        if (channel == nullptr)
+        {
+            continue; // fd 已被移除或被新的 Channel 占用, 丢弃过期事件
+        }
         // 将实际发生的事件 (epoll_event.events) 设置到 Channel 的 revents_ 成员中
         channel->set_revents(events_[i].events);
         // 将活跃的 Channel 添加到 EventLoop 提供的 activeChannels 列表中
@@ -146,17 +146,15 @@ void EPollPoller::fillActiveChannels(int numEvents, ChannelList *activeChannels)
 }
 
 // 实际调用 epoll_ctl 来执行添加、修改或删除操作
-void EPollPoller::update(int operation, Channel *channel)
+void EPollPoller::update(int operation, Channel *channel, uint32_t generation)
 {
     epoll_event event;
     bzero(&event, sizeof event);
     int fd = channel->fd();
     // 设置关心的事件掩码
     event.events = channel->events();
-    // 设置关联数据为文件描述符
-    event.data.fd = fd;
-    // 关键: 将 Channel 对象的指针存入 data.ptr，用于 poll 中快速获取
-    event.data.ptr = channel;
+    // 关联数据的高32位是表项的代数, 低32位是 fd, 用于 poll 中查表并识别过期事件
+    event.data.u64 = (static_cast<uint64_t>(generation) << 32) | static_cast<uint32_t>(fd);
 
     // 调用 epoll_ctl 系统调用
     if (::epoll_ctl(epollfd_, operation, fd, &event) < 0)
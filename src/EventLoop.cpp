@@ -1,5 +1,6 @@
 #include "EventLoop.h"
 
+#include <algorithm>
 #include <errno.h>
 #include <fcntl.h>
 #include <sys/eventfd.h>
@@ -8,12 +9,18 @@
 #include "Channel.h"
 #include "Logger.h"
 #include "Poller.h"
+#include "TimerQueue.h"
+#include "TimingWheel.h"
 
 // 保证一个线程内最多只能创建一个 EventLoop 对象
 __thread EventLoop* t_loopInThisThread = nullptr;
 
 // 定义默认的IO复用调用的超时时间
 const int kPollTimeMs = 10000;  // 默认10s
+// 忙轮询自适应调整时自旋时间的下限(微秒)
+const int kMinBusyPollUs = 1;
+// 每个loop的空闲回调节点链表最多保留的节点数, 超出的节点直接释放
+const uint64_t kMaxFreeFunctors = 1024;
 
 // 创建wakeupfd，用来notify唤醒subReactor处理新来的channel
 int createEventFd()
@@ -30,10 +37,16 @@ EventLoop::EventLoop()
     : looping_(false),
       quit_(false),
       callingPendingFunctors_(false),
+      pendingFunctors_(nullptr),
+      freeFunctors_(nullptr),
+      wakeupPending_(false),
       threadId_(CurrentThread::tid()),
+      busyPollMaxUs_(0),
+      busyPollBudgetUs_(0),
       poller_(Poller::newDefaultPoller(this)),
       wakeupFd_(createEventFd()),
-      wakeupChannel_(new Channel(this, wakeupFd_))
+      wakeupChannel_(new Channel(this, wakeupFd_)),
+      timerQueue_(new TimerQueue(this))
 //   currentActiveChannel_(nullptr)
 {
     LOG_DEBUG("EventLoop created %p in thread %d \n", this, threadId_);
@@ -46,6 +59,8 @@ EventLoop::EventLoop()
     {
         t_loopInThisThread = this;
     }
+    // 本线程之后创建的Buffer都从这个loop的内存池分配
+    BufferPool::setCurrent(&bufferPool_);
     // 设置wakeupfd的事件类型及发生事件后的回调操作
     wakeupChannel_->setReadCallback(std::bind(&EventLoop::handleRead, this));
     // 每个eventlop监听wakeupfd的EPOLLIN事件
@@ -58,6 +73,18 @@ EventLoop::~EventLoop()
     wakeupChannel_->remove();
     ::close(wakeupFd_);
     t_loopInThisThread = nullptr;
+    BufferPool::setCurrent(nullptr);
+    // 释放尚未执行的回调和空闲节点
+    PendingFunctor* lists[] = {pendingFunctors_.exchange(nullptr), freeFunctors_.exchange(nullptr)};
+    for (PendingFunctor* node : lists)
+    {
+        while (node)
+        {
+            PendingFunctor* next = node->next;
+            delete node;
+            node = next;
+        }
+    }
 }
 
 // 开启事件循环
@@ -68,18 +95,58 @@ void EventLoop::loop()
 
     LOG_INFO("EventLoop %p start looping \n", this);
 
+    uint64_t iterationEnd = 0;  // 上一轮结束的时间, 作为本轮 poll 的开始时间, 省去一次读时钟
     while (!quit_)
     {
         activeChannels_.clear();
+        bool timing = metrics_.enabled();
+        uint64_t pollStart = 0;
+        if (timing)
+        {
+            pollStart = iterationEnd ? iterationEnd : EventLoopMetrics::nowNs();
+        }
         // 监听两类fd   一种是client的fd，一种wakeupfd
-        pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+        if (busyPollMaxUs_ > 0)
+        {
+            pollReturnTime_ = busyPoll(kPollTimeMs);
+        }
+        else
+        {
+            pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+        }
+        EventLoopMetrics::increase(metrics_.iterations_, 1);
+        metrics_.eventsPerWakeup_.record(activeChannels_.size());
+
+        uint64_t busyStart = 0;
+        if (timing)
+        {
+            busyStart = EventLoopMetrics::nowNs();
+            metrics_.pollNs_.record(busyStart - pollStart);
+        }
+        uint64_t last = busyStart;
         for (Channel* channel : activeChannels_)  //遍历 Poller 返回的所有发生了事件的 Channel
         {
             // 调用每个活跃Channel的处理方法
             channel->handleEvent(pollReturnTime_);
+            if (timing)
+            {
+                // 上一个回调的结束时间就是下一个回调的开始时间
+                uint64_t now = EventLoopMetrics::nowNs();
+                metrics_.handlerNs_.record(now - last);
+                last = now;
+            }
         }
         // 执行当前EventLoop事件循环待处理的回调操作
-        doPendingFunctors();
+        doPendingFunctors(timing);
+        // 本轮产生的写操作在这里统一提交
+        doFlushFunctors();
+
+        iterationEnd = 0;
+        if (timing)
+        {
+            iterationEnd = EventLoopMetrics::nowNs();
+            EventLoopMetrics::increase(metrics_.busyNs_, iterationEnd - busyStart);
+        }
     }
 
     LOG_INFO("EventLoop %p stop looping. \n", this);
@@ -107,31 +174,177 @@ void EventLoop::runInLoop(Functor cb)
     }
     else
     {
-        queueInLoop(cb);
+        queueInLoop(std::move(cb));
+    }
+}
+
+// 投递线程私有的空闲节点缓存, 线程退出时释放
+struct EventLoop::FunctorCache
+{
+    FunctorCache() : head(nullptr) {}
+    ~FunctorCache()
+    {
+        while (head)
+        {
+            PendingFunctor* next = head->next;
+            delete head;
+            head = next;
+        }
+    }
+
+    PendingFunctor* head;
+};
+
+// 取一个空闲的回调节点: 先用本线程的缓存, 缓存用完时一次取走目标loop归还的整条空闲链表
+EventLoop::PendingFunctor* EventLoop::allocFunctor()
+{
+    static thread_local FunctorCache t_cache;
+    if (t_cache.head == nullptr && freeFunctors_.load(std::memory_order_relaxed) != nullptr)
+    {
+        t_cache.head = freeFunctors_.exchange(nullptr);
     }
+    PendingFunctor* node = t_cache.head;
+    if (node == nullptr)
+    {
+        return new PendingFunctor{Functor(), nullptr, 0};
+    }
+    t_cache.head = node->next;
+    node->next = nullptr;
+    node->enqueueNs = 0;
+    return node;
+}
+
+// 把执行完毕的节点(head 到 tail 共 count 个)归还到空闲链表, 只在loop线程中调用
+void EventLoop::recycleFunctors(PendingFunctor* head, PendingFunctor* tail, uint64_t count)
+{
+    // 投递线程只会整条取走空闲链表, 因此取回之后到放回之前不会有别人放入节点
+    PendingFunctor* free = freeFunctors_.exchange(nullptr);
+    uint64_t freeCount = free ? free->enqueueNs : 0;
+    while (head && freeCount + count > kMaxFreeFunctors)
+    {
+        PendingFunctor* next = head->next;
+        delete head;
+        head = next;
+        --count;
+    }
+    if (head)
+    {
+        tail->next = free;
+        head->enqueueNs = freeCount + count;
+        free = head;
+    }
+    freeFunctors_.store(free);
 }
 
 // 把cb放入队列，唤醒loop所在的线程，执行cb
 void EventLoop::queueInLoop(Functor cb)
 {
+    PendingFunctor* node = allocFunctor();
+    node->cb = std::move(cb);
+    // 先计数再入队, 保证 loop 减去的数量不会超过已经加上的数量
+    metrics_.addPending();
+    // 无锁压栈: 把新节点挂到链表头部
+    PendingFunctor* head = pendingFunctors_.load();
+    do
     {
-        std::unique_lock<std::mutex> lock(mutex_);
-        pendingFunctors_.emplace_back(cb);
-    }
+        node->next = head;
+        // 只给压入空栈的节点(下一批中最早的回调)记录投递时间, 每批只读一次时钟
+        if (head == nullptr && node->enqueueNs == 0 && metrics_.enabled())
+        {
+            node->enqueueNs = EventLoopMetrics::nowNs();
+        }
+    } while (!pendingFunctors_.compare_exchange_weak(head, node));
 
     // 唤醒逻辑:
     // 1. 如果调用 queueInLoop 的线程不是loop自己的线程 (通常情况)
     // 2. 如果是loop自己的线程在调用 queueInLoop，但它当前正在处理 pendingFunctors 队列
     //(意味着本次添加的 cb 不会在当前这轮 doPendingFunctors 中被执行，需要唤醒 loop让下一轮执行)
-    // 则需要唤醒 EventLoop 线程
+    // 则需要唤醒 EventLoop 线程; 已有未处理的唤醒时, 本次投递会在同一次唤醒中被执行, 不必再写 eventfd
     if (!isInLoopThread() || callingPendingFunctors_)
     {
-        wakeup();
+        if (!wakeupPending_.exchange(true))
+        {
+            wakeup();
+        }
     }
 }
 
+TimerId EventLoop::runAt(Timestamp time, TimerCallback cb)
+{
+    return timerQueue_->addTimer(std::move(cb), time, 0.0);
+}
+
+TimerId EventLoop::runAfter(double delay, TimerCallback cb)
+{
+    Timestamp time(addTime(Timestamp::now(), delay));
+    return runAt(time, std::move(cb));
+}
+
+TimerId EventLoop::runEvery(double interval, TimerCallback cb)
+{
+    Timestamp time(addTime(Timestamp::now(), interval));
+    return timerQueue_->addTimer(std::move(cb), time, interval);
+}
+
+void EventLoop::cancel(TimerId timerId) { timerQueue_->cancel(timerId); }
+
+TimingWheel* EventLoop::timingWheel()
+{
+    if (!timingWheel_)
+    {
+        timingWheel_.reset(new TimingWheel(this));
+    }
+    return timingWheel_.get();
+}
+
+void EventLoop::setBusyPoll(int maxSpinUs)
+{
+    busyPollMaxUs_ = maxSpinUs > 0 ? maxSpinUs : 0;
+    busyPollBudgetUs_ = busyPollMaxUs_;
+}
+
+Timestamp EventLoop::busyPoll(int timeoutMs)
+{
+    // 1. 自旋: 以 0 超时反复 poll, 直到有事件或用完本次的自旋时间
+    int64_t spinStart = Timestamp::now().microSecondsSinceEpoch();
+    int64_t spinDeadline = spinStart + busyPollBudgetUs_;
+    Timestamp now;
+    do
+    {
+        now = poller_->poll(0, &activeChannels_);
+        if (!activeChannels_.empty())
+        {
+            return now;
+        }
+    } while (now.microSecondsSinceEpoch() < spinDeadline);
+
+    // 2. 自旋落空, 阻塞等待
+    Timestamp blockStart(Timestamp::now());
+    now = poller_->poll(timeoutMs, &activeChannels_);
+
+    // 3. 根据阻塞了多久调整下次的自旋时间
+    int64_t blockedUs = now.microSecondsSinceEpoch() - blockStart.microSecondsSinceEpoch();
+    if (blockedUs <= busyPollMaxUs_)
+    {
+        // 很快就来了事件: 多自旋一会儿就能避免这次睡眠
+        busyPollBudgetUs_ = std::min(busyPollMaxUs_, std::max(busyPollBudgetUs_ * 2, kMinBusyPollUs));
+    }
+    else
+    {
+        // 流量稀疏: 少浪费一些CPU
+        busyPollBudgetUs_ = std::max(kMinBusyPollUs, busyPollBudgetUs_ / 2);
+    }
+    return now;
+}
+
+void EventLoop::queueFlush(Functor cb) { flushFunctors_.emplace_back(std::move(cb)); }
+
+void EventLoop::queueNextFlush(Functor cb) { nextFlushFunctors_.emplace_back(std::move(cb)); }
+
 void EventLoop::handleRead()
 {
+    // 先清除标志再取回调链表: 清除之后的投递会重新唤醒, 之前的投递一定会被本轮 doPendingFunctors 取走
+    wakeupPending_ = false;
     uint64_t one = 1;
     ssize_t n = ::read(wakeupFd_, &one, sizeof one);
     if (n != sizeof one)
@@ -159,24 +372,99 @@ void EventLoop::removeChannel(Channel* channel) { poller_->removeChannel(channel
 
 bool EventLoop::hasChannel(Channel* channel) { return poller_->hasChannel(channel); }
 
+bool EventLoop::supportsEdgeTriggered() const { return poller_->supportsEdgeTriggered(); }
+
 // 执行回调
-void EventLoop::doPendingFunctors()
+void EventLoop::doPendingFunctors(bool timing)
 {
-    std::vector<Functor> functors;   // 1. 创建一个局部的临时 vector
+    // 1. 一次性取走整条链表, 不持有任何锁
+    PendingFunctor* node = pendingFunctors_.exchange(nullptr);
+    if (node == nullptr)
+    {
+        return;
+    }
     callingPendingFunctors_ = true;  // 2. 设置标志位，表示正在处理回调
 
+    // 3. 链表是后进先出的, 原地反转为投递顺序
+    PendingFunctor* ordered = nullptr;
+    uint64_t count = 0;
+    while (node)
     {
-        std::unique_lock<std::mutex> lock(mutex_);
-        // 3. swap 操作: 高效地将 pendingFunctors_ 的内容转移到局部 functors,同时将 pendingFunctors_
-        // 清空,极大地缩短了锁的持有时间！
-        functors.swap(pendingFunctors_);
+        PendingFunctor* next = node->next;
+        node->next = ordered;
+        ordered = node;
+        node = next;
+        ++count;
     }
+    metrics_.removePending(count);
+    metrics_.pendingBatch_.record(count);
 
-    // 4. 遍历并执行从队列中取出的所有回调
-    for (const Functor& functor : functors)
+    // 4. 按投递顺序执行, 执行完的节点归还到空闲链表供之后的投递复用
+    uint64_t start = 0;
+    if (timing)
+    {
+        start = EventLoopMetrics::nowNs();
+        // 排队时间: 本批最早的回调从投递到开始执行
+        uint64_t enqueueNs = ordered->enqueueNs;
+        if (enqueueNs != 0)
+        {
+            metrics_.queueDelayNs_.record(start > enqueueNs ? start - enqueueNs : 0);
+        }
+    }
+    // 每批最多归还 kMaxFreeFunctors 个节点, 其余的执行完直接释放, 避免再遍历一遍大批次
+    PendingFunctor* done = nullptr;
+    PendingFunctor* doneTail = ordered;
+    uint64_t doneCount = 0;
+    while (ordered)
+    {
+        PendingFunctor* next = ordered->next;
+        ordered->cb();  // 执行回调
+        if (doneCount < kMaxFreeFunctors)
+        {
+            ordered->cb = nullptr;  // 立即释放回调持有的对象(如 TcpConnection 的 shared_ptr)
+            ordered->next = done;
+            done = ordered;
+            ++doneCount;
+        }
+        else
+        {
+            delete ordered;
+        }
+        ordered = next;
+    }
+    recycleFunctors(done, doneTail, doneCount);
+    if (timing)
     {
-        functor();  // 执行回调
+        metrics_.pendingNs_.record(EventLoopMetrics::nowNs() - start);
     }
 
     callingPendingFunctors_ = false;  // 5. 清除标志位，表示处理完毕
+}
+
+// 执行本轮循环的收尾回调
+void EventLoop::doFlushFunctors()
+{
+    // 收尾回调中调用 queueInLoop 的回调需要唤醒下一轮循环, 因此复用 callingPendingFunctors_ 标志
+    callingPendingFunctors_ = true;
+    // 之前推迟的回调排在本轮收尾回调之后; 本轮收尾阶段中推迟的回调留到下一轮
+    if (!nextFlushFunctors_.empty())
+    {
+        for (Functor& functor : nextFlushFunctors_)
+        {
+            flushFunctors_.emplace_back(std::move(functor));
+        }
+        nextFlushFunctors_.clear();
+    }
+    // 收尾回调可能继续登记收尾回调(如回调中再次发送数据), 一直执行到队列为空
+    while (!flushFunctors_.empty())
+    {
+        // 与临时容器交换, 两个容器的容量都在循环之间复用
+        flushScratch_.swap(flushFunctors_);
+        for (const Functor& functor : flushScratch_)
+        {
+            functor();
+        }
+        flushScratch_.clear();
+    }
+    callingPendingFunctors_ = false;
 }
\ No newline at end of file
@@ -0,0 +1,105 @@
+#include "EventLoopMetrics.h"
+
+#include <stdio.h>
+
+const int Log2Histogram::kNumBuckets;
+
+Log2Histogram::Log2Histogram() : count_(0), sum_(0), max_(0)
+{
+    for (int i = 0; i < kNumBuckets; ++i)
+    {
+        buckets_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+Log2Histogram::Snapshot Log2Histogram::snapshot() const
+{
+    Snapshot snap;
+    snap.count = count_.load(std::memory_order_relaxed);
+    snap.sum = sum_.load(std::memory_order_relaxed);
+    snap.max = max_.load(std::memory_order_relaxed);
+    for (int i = 0; i < kNumBuckets; ++i)
+    {
+        snap.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+    }
+    return snap;
+}
+
+uint64_t Log2Histogram::Snapshot::percentile(double p) const
+{
+    // 读取快照时写入方可能正在更新, 以各个桶之和为准
+    uint64_t total = 0;
+    for (int i = 0; i < kNumBuckets; ++i)
+    {
+        total += buckets[i];
+    }
+    if (total == 0)
+    {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(total));
+    if (rank >= total)
+    {
+        rank = total - 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < kNumBuckets; ++i)
+    {
+        seen += buckets[i];
+        if (seen > rank)
+        {
+            uint64_t upper = i == 0 ? 0 : (i == kNumBuckets - 1 ? max : (1ULL << i) - 1);
+            return upper < max ? upper : max;
+        }
+    }
+    return max;
+}
+
+double EventLoopMetrics::Snapshot::utilization() const
+{
+    double total = static_cast<double>(busyNs) + static_cast<double>(pollNs.sum);
+    return total > 0 ? static_cast<double>(busyNs) / total : 0.0;
+}
+
+std::string EventLoopMetrics::Snapshot::toString() const
+{
+    char buf[512];
+    snprintf(buf, sizeof buf,
+             "iterations=%llu connections=%lld util=%.1f%% poll(p50=%lluus max=%lluus) "
+             "events/wakeup(mean=%.1f max=%llu) handler(p50=%lluns p99=%lluns max=%lluns) "
+             "pending(depth=%llu batch mean=%.1f max=%llu time p99=%lluns delay p99=%lluns)",
+             static_cast<unsigned long long>(iterations), static_cast<long long>(connections),
+             utilization() * 100,
+             static_cast<unsigned long long>(pollNs.percentile(0.5) / 1000),
+             static_cast<unsigned long long>(pollNs.max / 1000), eventsPerWakeup.mean(),
+             static_cast<unsigned long long>(eventsPerWakeup.max),
+             static_cast<unsigned long long>(handlerNs.percentile(0.5)),
+             static_cast<unsigned long long>(handlerNs.percentile(0.99)),
+             static_cast<unsigned long long>(handlerNs.max),
+             static_cast<unsigned long long>(pendingDepth), pendingBatch.mean(),
+             static_cast<unsigned long long>(pendingBatch.max),
+             static_cast<unsigned long long>(pendingNs.percentile(0.99)),
+             static_cast<unsigned long long>(queueDelayNs.percentile(0.99)));
+    return buf;
+}
+
+EventLoopMetrics::EventLoopMetrics()
+    : enabled_(true), iterations_(0), busyNs_(0), pendingDepth_(0), connections_(0)
+{
+}
+
+EventLoopMetrics::Snapshot EventLoopMetrics::snapshot() const
+{
+    Snapshot snap;
+    snap.iterations = iterations_.load(std::memory_order_relaxed);
+    snap.busyNs = busyNs_.load(std::memory_order_relaxed);
+    snap.pendingDepth = pendingDepth_.load(std::memory_order_relaxed);
+    snap.connections = connections_.load(std::memory_order_relaxed);
+    snap.pollNs = pollNs_.snapshot();
+    snap.eventsPerWakeup = eventsPerWakeup_.snapshot();
+    snap.handlerNs = handlerNs_.snapshot();
+    snap.pendingBatch = pendingBatch_.snapshot();
+    snap.pendingNs = pendingNs_.snapshot();
+    snap.queueDelayNs = queueDelayNs_.snapshot();
+    return snap;
+}
\ No newline at end of file
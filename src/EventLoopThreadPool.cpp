@@ -1,9 +1,28 @@
 #include "EventLoopThreadPool.h"
 
+#include <string.h>
+
+#include "EventLoop.h"
 #include "EventLoopThread.h"
+#include "InetAddress.h"
+
+const uint64_t EventLoopThreadPool::kLoadRefreshNs;
+
+namespace
+{
+// 两个 loop 最近的忙碌占比相差超过该值时按忙碌占比选择, 否则按排队的回调数和连接数选择
+const double kUtilizationSlack = 0.05;
+}  // namespace
 
 EventLoopThreadPool::EventLoopThreadPool(EventLoop* baseLoop, const std::string& nameArg)
-    : baseLoop_(baseLoop), name_(nameArg), started_(false), threadNum_(0), next_(0)
+    : baseLoop_(baseLoop),
+      name_(nameArg),
+      started_(false),
+      threadNum_(0),
+      next_(0),
+      strategy_(kRoundRobin),
+      lastRefreshNs_(0),
+      randomState_(reinterpret_cast<uintptr_t>(this) | 1)
 {
 }
 
@@ -26,6 +45,7 @@ void EventLoopThreadPool::start(const ThreadInitCallback& cb)
         // 4. 启动 EventLoopThread 并获取其内部的 EventLoop 指针
         loops_.push_back(t->startLoop());
     }
+    loads_.assign(loops_.size(), LoopLoad{0, 0, 0.0});
 
     if (threadNum_ == 0 && cb)
     {
@@ -54,6 +74,145 @@ EventLoop* EventLoopThreadPool::getNextLoop()
     return loop;
 }
 
+EventLoop* EventLoopThreadPool::getNextLoop(const InetAddress& peerAddr)
+{
+    if (loops_.empty())
+    {
+        return baseLoop_;
+    }
+    if (selector_)
+    {
+        EventLoop* loop = selector_(loops_, peerAddr);
+        return loop ? loop : getNextLoop();
+    }
+    switch (strategy_)
+    {
+        case kLeastConnections:
+            return getLeastConnectionsLoop();
+        case kPowerOfTwoChoices:
+            return getPowerOfTwoChoicesLoop();
+        case kHashByPeer:
+        {
+            const sockaddr_in* addr = peerAddr.getSockAddr();
+            uint32_t ip = 0;
+            ::memcpy(&ip, &addr->sin_addr, sizeof ip);
+            // 乘法哈希, 打散相邻的地址
+            uint64_t hash = static_cast<uint64_t>(ip) * 0x9E3779B97F4A7C15ULL;
+            return getLoopForHash(static_cast<size_t>(hash >> 32));
+        }
+        case kRoundRobin:
+        default:
+            return getNextLoop();
+    }
+}
+
+EventLoop* EventLoopThreadPool::getLoopForHash(size_t hashCode)
+{
+    if (loops_.empty())
+    {
+        return baseLoop_;
+    }
+    return loops_[hashCode % loops_.size()];
+}
+
+EventLoop* EventLoopThreadPool::getLeastConnectionsLoop()
+{
+    // 从轮询位置开始扫描, 连接数相同时依次分散到不同的 loop
+    size_t n = loops_.size();
+    size_t start = static_cast<size_t>(next_);
+    size_t best = start;
+    int64_t bestConnections = loops_[start]->metrics().connections();
+    for (size_t i = 1; i < n; ++i)
+    {
+        size_t idx = (start + i) % n;
+        int64_t connections = loops_[idx]->metrics().connections();
+        if (connections < bestConnections)
+        {
+            best = idx;
+            bestConnections = connections;
+        }
+    }
+    next_ = static_cast<int>((start + 1) % n);
+    return loops_[best];
+}
+
+EventLoop* EventLoopThreadPool::getPowerOfTwoChoicesLoop()
+{
+    size_t n = loops_.size();
+    if (n == 1)
+    {
+        return loops_[0];
+    }
+    refreshLoads();
+    // xorshift64
+    randomState_ ^= randomState_ << 13;
+    randomState_ ^= randomState_ >> 7;
+    randomState_ ^= randomState_ << 17;
+    size_t a = static_cast<size_t>(randomState_ % n);
+    size_t b = static_cast<size_t>((randomState_ >> 32) % (n - 1));
+    if (b >= a)
+    {
+        ++b;  // 保证 a != b
+    }
+    return loops_[lessLoaded(b, a) ? b : a];
+}
+
+void EventLoopThreadPool::refreshLoads()
+{
+    uint64_t now = EventLoopMetrics::nowNs();
+    if (now - lastRefreshNs_ < kLoadRefreshNs)
+    {
+        return;
+    }
+    lastRefreshNs_ = now;
+    for (size_t i = 0; i < loops_.size(); ++i)
+    {
+        const EventLoopMetrics& metrics = loops_[i]->metrics();
+        LoopLoad& load = loads_[i];
+        uint64_t busyNs = metrics.busyNs();
+        uint64_t pollNs = metrics.pollNs();
+        uint64_t busyDelta = busyNs - load.busyNs;
+        uint64_t pollDelta = pollNs - load.pollNs;
+        load.busyNs = busyNs;
+        load.pollNs = pollNs;
+        if (busyDelta + pollDelta > 0)
+        {
+            load.utilization = static_cast<double>(busyDelta) / (busyDelta + pollDelta);
+        }
+        else
+        {
+            // 整个周期内一轮循环都没有结束: 要么阻塞在 poll 中(空闲), 要么卡在某个回调中(饱和),
+            // 用是否有排队的回调区分
+            load.utilization = metrics.pendingDepth() > 0 ? 1.0 : 0.0;
+        }
+    }
+}
+
+std::vector<double> EventLoopThreadPool::getRecentUtilizations()
+{
+    refreshLoads();
+    std::vector<double> utilizations;
+    utilizations.reserve(loads_.size());
+    for (const LoopLoad& load : loads_)
+    {
+        utilizations.push_back(load.utilization);
+    }
+    return utilizations;
+}
+
+bool EventLoopThreadPool::lessLoaded(size_t a, size_t b) const
+{
+    double utilDiff = loads_[a].utilization - loads_[b].utilization;
+    if (utilDiff < -kUtilizationSlack || utilDiff > kUtilizationSlack)
+    {
+        return utilDiff < 0;
+    }
+    const EventLoopMetrics& ma = loops_[a]->metrics();
+    const EventLoopMetrics& mb = loops_[b]->metrics();
+    return static_cast<int64_t>(ma.pendingDepth()) + ma.connections() <
+           static_cast<int64_t>(mb.pendingDepth()) + mb.connections();
+}
+
 std::vector<EventLoop*> EventLoopThreadPool::getAllLoops()
 {
     // 如果没有工作线程，返回只包含 baseLoop_ 的 vector
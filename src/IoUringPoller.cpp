@@ -0,0 +1,385 @@
+#include "IoUringPoller.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "Channel.h"
+#include "Logger.h"
+
+const int IoUringPoller::kEntries;
+const uint64_t IoUringPoller::kIgnoredUserData;
+
+// poll 请求不支持的 epoll 专用标志
+static const uint32_t kEpollOnlyFlags = EPOLLET | EPOLLONESHOT | EPOLLEXCLUSIVE | EPOLLWAKEUP;
+
+static int ioUringSetup(unsigned entries, io_uring_params* p)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, p));
+}
+
+static int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags,
+                        const void* arg, size_t argsz)
+{
+    return static_cast<int>(
+        ::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argsz));
+}
+
+IoUringPoller* IoUringPoller::create(EventLoop* loop)
+{
+    IoUringPoller* poller = new IoUringPoller(loop);
+    if (!poller->init())
+    {
+        delete poller;
+        return nullptr;
+    }
+    return poller;
+}
+
+IoUringPoller::IoUringPoller(EventLoop* loop)
+    : Poller(loop),
+      ringFd_(-1),
+      sqEntries_(0),
+      sqRing_(MAP_FAILED),
+      sqRingSize_(0),
+      cqRing_(MAP_FAILED),
+      cqRingSize_(0),
+      sqes_(nullptr),
+      sqesSize_(0),
+      sqHead_(nullptr),
+      sqTail_(nullptr),
+      sqMask_(nullptr),
+      sqArray_(nullptr),
+      cqHead_(nullptr),
+      cqTail_(nullptr),
+      cqMask_(nullptr),
+      cqes_(nullptr)
+{
+}
+
+IoUringPoller::~IoUringPoller()
+{
+    if (sqes_)
+    {
+        ::munmap(sqes_, sqesSize_);
+    }
+    if (cqRing_ != MAP_FAILED && cqRing_ != sqRing_)
+    {
+        ::munmap(cqRing_, cqRingSize_);
+    }
+    if (sqRing_ != MAP_FAILED)
+    {
+        ::munmap(sqRing_, sqRingSize_);
+    }
+    if (ringFd_ >= 0)
+    {
+        ::close(ringFd_);
+    }
+}
+
+bool IoUringPoller::init()
+{
+    io_uring_params params;
+    ::memset(&params, 0, sizeof params);
+    ringFd_ = ioUringSetup(kEntries, &params);
+    if (ringFd_ < 0)
+    {
+        LOG_ERROR("io_uring_setup error:%d \n", errno);
+        return false;
+    }
+    // 带超时的等待需要 IORING_ENTER_EXT_ARG(5.11+)
+    if (!(params.features & IORING_FEAT_EXT_ARG))
+    {
+        LOG_ERROR("io_uring lacks IORING_FEAT_EXT_ARG, kernel too old \n");
+        return false;
+    }
+
+    sqEntries_ = params.sq_entries;
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMmap)
+    {
+        // 提交队列和完成队列共用一次映射
+        sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+    }
+    sqRing_ = ::mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     ringFd_, IORING_OFF_SQ_RING);
+    if (sqRing_ == MAP_FAILED)
+    {
+        LOG_ERROR("io_uring mmap sq ring error:%d \n", errno);
+        return false;
+    }
+    if (singleMmap)
+    {
+        cqRing_ = sqRing_;
+    }
+    else
+    {
+        cqRing_ = ::mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         ringFd_, IORING_OFF_CQ_RING);
+        if (cqRing_ == MAP_FAILED)
+        {
+            LOG_ERROR("io_uring mmap cq ring error:%d \n", errno);
+            return false;
+        }
+    }
+    sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = ::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ringFd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+    {
+        LOG_ERROR("io_uring mmap sqes error:%d \n", errno);
+        return false;
+    }
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(sqRing_);
+    sqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqMask_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    char* cq = static_cast<char*>(cqRing_);
+    cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    LOG_INFO("IoUringPoller created, fd=%d sq_entries=%u cq_entries=%u \n", ringFd_,
+             params.sq_entries, params.cq_entries);
+    return true;
+}
+
+Timestamp IoUringPoller::poll(int timeoutMs, ChannelList* activeChannels)
+{
+    // 1. 重新提交上一轮返回过事件、仍然关心事件的 Channel
+    for (int fd : rearmFds_)
+    {
+        PollState& state = stateOf(fd);
+        if (!state.pendingRearm)
+        {
+            continue;  // 期间已被删除或重新注册
+        }
+        state.pendingRearm = false;
+        Channel* channel = channelOf(fd);
+        if (channel && !channel->isNoneEvent() && !state.armed)
+        {
+            arm(channel);
+        }
+    }
+    rearmFds_.clear();
+
+    // 2. 一次系统调用提交所有请求并等待事件; 完成队列中已有事件时不再等待
+    bool hasCompletions = *cqHead_ != __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    unsigned waitNr = (hasCompletions || timeoutMs == 0) ? 0 : 1;
+    int ret = enter(waitNr, timeoutMs);
+    int saveErrno = errno;
+    Timestamp now(Timestamp::now());
+    if (ret < 0 && saveErrno != ETIME && saveErrno != EINTR)
+    {
+        errno = saveErrno;
+        LOG_ERROR("IoUringPoller::poll() error!");
+    }
+
+    // 3. 取出完成事件
+    int numEvents = reapCompletions(activeChannels);
+    if (numEvents > 0)
+    {
+        LOG_DEBUG("%d events happened \n", numEvents);
+    }
+    return now;
+}
+
+void IoUringPoller::updateChannel(Channel* channel)
+{
+    ChannelSlot* slot = findSlot(channel);
+    int fd = channel->fd();
+    LOG_DEBUG("func=%s => fd=%d events=%d state=%d\n", __FUNCTION__, fd, channel->events(),
+              slot ? slot->state : kNew);
+
+    if (slot == nullptr || slot->state == kDeleted)
+    {
+        if (slot == nullptr)
+        {
+            slot = &insertChannel(channel);
+        }
+        slot->state = kAdded;
+        arm(channel);
+    }
+    else
+    {
+        PollState& state = stateOf(fd);
+        if (channel->isNoneEvent())
+        {
+            disarm(fd);
+            slot->state = kDeleted;
+        }
+        else if (state.armed)
+        {
+            // 关心的事件变了: 撤销旧请求, 按新的事件重新提交
+            disarm(fd);
+            arm(channel);
+        }
+        else if (!state.pendingRearm)
+        {
+            arm(channel);
+        }
+        // 等待重新提交时什么也不做, 重新提交时会使用最新的事件
+    }
+}
+
+void IoUringPoller::removeChannel(Channel* channel)
+{
+    int fd = channel->fd();
+    LOG_DEBUG("func=%s => fd=%d\n", __FUNCTION__, fd);
+    ChannelSlot* slot = findSlot(channel);
+    if (slot == nullptr)
+    {
+        return;
+    }
+    if (slot->state == kAdded)
+    {
+        disarm(fd);
+    }
+    eraseChannel(fd);
+}
+
+void IoUringPoller::arm(Channel* channel)
+{
+    int fd = channel->fd();
+    PollState& state = stateOf(fd);
+    ++state.generation;
+    io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = static_cast<uint32_t>(channel->events()) & ~kEpollOnlyFlags;
+    // user_data 的高32位是代数, 低32位是 fd
+    sqe->user_data = (static_cast<uint64_t>(state.generation) << 32) | static_cast<uint32_t>(fd);
+    state.armed = true;
+    state.pendingRearm = false;
+}
+
+void IoUringPoller::disarm(int fd)
+{
+    PollState& state = stateOf(fd);
+    if (state.armed)
+    {
+        io_uring_sqe* sqe = getSqe();
+        sqe->opcode = IORING_OP_POLL_REMOVE;
+        sqe->fd = -1;
+        sqe->addr = (static_cast<uint64_t>(state.generation) << 32) | static_cast<uint32_t>(fd);
+        sqe->user_data = kIgnoredUserData;
+        state.armed = false;
+    }
+    // 代数加一, 被撤销请求的完成事件(无论是已就绪还是 -ECANCELED)都会被丢弃
+    ++state.generation;
+    state.pendingRearm = false;
+}
+
+io_uring_sqe* IoUringPoller::getSqe()
+{
+    unsigned tail = *sqTail_;
+    if (tail - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_)
+    {
+        // 提交队列满了: 先把已有请求交给内核
+        enter(0, 0);
+        if (tail - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_)
+        {
+            LOG_FATAL("IoUringPoller submission queue is full \n");
+        }
+    }
+    unsigned index = tail & *sqMask_;
+    io_uring_sqe* sqe = &sqes_[index];
+    ::memset(sqe, 0, sizeof *sqe);
+    sqArray_[index] = index;
+    // 没有使用 SQPOLL, 内核只在 io_uring_enter 时读取提交队列, 可以先发布尾指针再填写内容
+    __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+    return sqe;
+}
+
+int IoUringPoller::enter(unsigned waitNr, int timeoutMs)
+{
+    unsigned toSubmit = *sqTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    if (toSubmit == 0 && waitNr == 0)
+    {
+        return 0;
+    }
+    unsigned flags = 0;
+    const void* arg = nullptr;
+    size_t argsz = 0;
+    __kernel_timespec ts;
+    io_uring_getevents_arg getEventsArg;
+    if (waitNr > 0)
+    {
+        flags |= IORING_ENTER_GETEVENTS;
+        if (timeoutMs >= 0)
+        {
+            ts.tv_sec = timeoutMs / 1000;
+            ts.tv_nsec = static_cast<long long>(timeoutMs % 1000) * 1000 * 1000;
+            ::memset(&getEventsArg, 0, sizeof getEventsArg);
+            getEventsArg.ts = reinterpret_cast<uint64_t>(&ts);
+            flags |= IORING_ENTER_EXT_ARG;
+            arg = &getEventsArg;
+            argsz = sizeof getEventsArg;
+        }
+    }
+    return ioUringEnter(ringFd_, toSubmit, waitNr, flags, arg, argsz);
+}
+
+int IoUringPoller::reapCompletions(ChannelList* activeChannels)
+{
+    int numEvents = 0;
+    unsigned head = *cqHead_;
+    unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    while (head != tail)
+    {
+        const io_uring_cqe* cqe = &cqes_[head & *cqMask_];
+        uint64_t userData = cqe->user_data;
+        int res = cqe->res;
+        ++head;
+        if (userData == kIgnoredUserData)
+        {
+            continue;
+        }
+        int fd = static_cast<int>(userData & 0xffffffff);
+        uint32_t generation = static_cast<uint32_t>(userData >> 32);
+        PollState& state = stateOf(fd);
+        if (generation != state.generation || !state.armed)
+        {
+            continue;  // 已被撤销或重新注册的请求
+        }
+        state.armed = false;
+        Channel* channel = channelOf(fd);
+        if (channel == nullptr)
+        {
+            continue;
+        }
+        if (res < 0)
+        {
+            // 请求失败时也要上报并重新提交, 否则这个 fd 再也不会被监听, 连接会无声地挂起
+            LOG_ERROR("IoUringPoller poll fd=%d error:%d \n", fd, -res);
+            res = EPOLLERR;
+        }
+        // poll 返回的事件掩码与 epoll 的取值相同
+        channel->set_revents(res);
+        activeChannels->push_back(channel);
+        state.pendingRearm = true;
+        rearmFds_.push_back(fd);
+        ++numEvents;
+    }
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+    return numEvents;
+}
+
+IoUringPoller::PollState& IoUringPoller::stateOf(int fd)
+{
+    if (static_cast<size_t>(fd) >= states_.size())
+    {
+        states_.resize(fd + 1);
+    }
+    return states_[fd];
+}
\ No newline at end of file
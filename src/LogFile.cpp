@@ -0,0 +1,109 @@
+#include "LogFile.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+const int LogFile::kRollPerSeconds;
+const size_t LogFile::kFileBufferSize;
+
+LogFile::LogFile(const std::string& basename, off_t rollSize, RollCallback cb)
+    : basename_(basename),
+      rollSize_(rollSize),
+      rollCallback_(std::move(cb)),
+      writtenBytes_(0),
+      startOfPeriod_(0),
+      fp_(nullptr)
+{
+    rollFile();
+}
+
+LogFile::~LogFile()
+{
+    if (fp_)
+    {
+        ::fclose(fp_);
+    }
+}
+
+void LogFile::append(const char* data, size_t len)
+{
+    time_t now = ::time(nullptr);
+    if (fp_ == nullptr || writtenBytes_ >= rollSize_ ||
+        now / kRollPerSeconds * kRollPerSeconds != startOfPeriod_)
+    {
+        rollFile();
+    }
+    if (fp_ == nullptr)
+    {
+        // 文件打不开时退回标准错误, 不能使用 LOG_* 以免递归
+        ::fwrite(data, 1, len, stderr);
+        return;
+    }
+    size_t written = ::fwrite_unlocked(data, 1, len, fp_);
+    if (written != len)
+    {
+        ::fprintf(stderr, "LogFile::append failed: %s\n", ::strerror(errno));
+    }
+    writtenBytes_ += written;
+}
+
+void LogFile::flush()
+{
+    if (fp_)
+    {
+        ::fflush(fp_);
+    }
+}
+
+void LogFile::rollFile()
+{
+    time_t now = ::time(nullptr);
+    std::string filename = getLogFileName(basename_, now);
+    if (fp_)
+    {
+        ::fclose(fp_);
+    }
+    fp_ = ::fopen(filename.c_str(), "ae");  // e: O_CLOEXEC
+    if (fp_)
+    {
+        ::setvbuf(fp_, buffer_, _IOFBF, sizeof buffer_);
+    }
+    else
+    {
+        ::fprintf(stderr, "LogFile::rollFile open %s failed: %s\n", filename.c_str(),
+                  ::strerror(errno));
+    }
+    writtenBytes_ = 0;
+    startOfPeriod_ = now / kRollPerSeconds * kRollPerSeconds;
+    if (fp_ && rollCallback_)
+    {
+        rollCallback_(this);
+    }
+}
+
+std::string LogFile::getLogFileName(const std::string& basename, time_t now)
+{
+    std::string filename(basename);
+    char timebuf[32];
+    struct tm tm;
+    ::localtime_r(&now, &tm);
+    ::strftime(timebuf, sizeof timebuf, ".%Y%m%d-%H%M%S.", &tm);
+    filename += timebuf;
+
+    char hostname[256];
+    if (::gethostname(hostname, sizeof hostname) == 0)
+    {
+        hostname[sizeof hostname - 1] = '\0';
+        filename += hostname;
+    }
+    else
+    {
+        filename += "unknownhost";
+    }
+
+    char pidbuf[32];
+    ::snprintf(pidbuf, sizeof pidbuf, ".%d.log", ::getpid());
+    filename += pidbuf;
+    return filename;
+}
\ No newline at end of file
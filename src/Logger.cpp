@@ -1,7 +1,46 @@
 #include "Logger.h"
-#include "Timestamp.h"
+#include "AsyncLogging.h"
 
-#include <iostream>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+std::atomic<int> Logger::logLevel_(MUDUO_LOG_MIN_LEVEL);
+std::atomic<bool> Logger::binary_(false);
+
+namespace
+{
+// 单条日志消息的最大长度, 超出部分被截断
+const int kMaxMessageLen = 1024;
+
+const char *const kLevelNames[] = {"[DEBUG]", "[INFO]", "[ERROR]", "[FATAL]"};
+
+// 每个线程缓存上一次格式化的时间, 同一秒内的日志直接复用
+__thread time_t t_lastSecond = 0;
+__thread char t_time[32];
+__thread int t_timeLen = 0;
+
+int formatTime(char *buf)
+{
+    time_t now = ::time(nullptr);
+    if (now != t_lastSecond)
+    {
+        t_lastSecond = now;
+        struct tm tm_time;
+        ::localtime_r(&now, &tm_time);
+        t_timeLen = snprintf(t_time, sizeof t_time, "%4d/%02d/%02d %02d:%02d:%02d",
+                             tm_time.tm_year + 1900, // tm_year 是从 1900 年开始计数的
+                             tm_time.tm_mon + 1,     // tm_mon 是从 0 开始计数的
+                             tm_time.tm_mday,
+                             tm_time.tm_hour,
+                             tm_time.tm_min,
+                             tm_time.tm_sec);
+    }
+    memcpy(buf, t_time, t_timeLen);
+    return t_timeLen;
+}
+} // namespace
 
 // 获取日志唯一的实例对象
 Logger &Logger::getinstance()
@@ -10,33 +49,118 @@ Logger &Logger::getinstance()
     return logger;
 }
 
-// 设置日志级别
-void Logger::setLogLevel(int level)
+Logger::Logger()
+    : async_(nullptr),
+      binaryLogging_(nullptr)
+{
+}
+
+Logger::~Logger()
+{
+    stopBinary();
+    stopAsync();
+}
+
+// 写日志  [级别信息]time : msg
+void Logger::log(int level, const char *fmt, ...)
+{
+    char buf[kMaxMessageLen + 64];
+    const char *name = kLevelNames[level >= DEBUG && level <= FATAL ? level : INFO];
+    size_t nameLen = strlen(name);
+    memcpy(buf, name, nameLen);
+    int len = static_cast<int>(nameLen);
+    len += formatTime(buf + len);
+    memcpy(buf + len, " : ", 3);
+    len += 3;
+
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buf + len, kMaxMessageLen, fmt, args);
+    va_end(args);
+    if (n > 0)
+    {
+        len += n < kMaxMessageLen ? n : kMaxMessageLen - 1;
+    }
+    // 消息自带换行时不再追加
+    if (buf[len - 1] != '\n')
+    {
+        buf[len++] = '\n';
+    }
+
+    AsyncLogging *async = async_.load(std::memory_order_acquire);
+    if (async == nullptr || !async->append(buf, len))
+    {
+        output(buf, len);
+    }
+    if (level >= FATAL)
+    {
+        flush();
+    }
+}
+
+void Logger::output(const char *data, size_t len)
 {
-    logLevel_ = level;
+    fwrite(data, 1, len, stdout);
 }
 
-// 写日志  [级别信息] time : msg
-void Logger::log(std::string msg)
+void Logger::startAsync(const std::string &basename, off_t rollSize, int flushInterval)
 {
-    switch (logLevel_)
+    if (async_.load(std::memory_order_acquire) != nullptr)
     {
-    case INFO:
-        std::cout << "[INFO]";
-        break;
-    case ERROR:
-        std::cout << "[ERROR]";
-        break;
-    case FATAL:
-        std::cout << "[FATAL]";
-        break;
-    case DEBUG:
-        std::cout << "[DEBUG]";
-        break;
-    default:
-        break;
+        LOG_ERROR("Logger::startAsync called more than once \n");
+        return;
     }
+    fflush(stdout);
+    AsyncLogging *async = new AsyncLogging(basename, rollSize, flushInterval);
+    async->start();
+    async_.store(async, std::memory_order_release);
+}
 
-    // 打印时间和msg
-    std::cout << Timestamp::now().toString() << " : " << msg << std::endl;
+void Logger::stopAsync()
+{
+    // 后端对象保留到进程结束: 其他线程可能仍持有它的指针, stop 之后 append 会失败并回到同步输出
+    AsyncLogging *async = async_.load(std::memory_order_acquire);
+    if (async)
+    {
+        async->stop();
+    }
+}
+
+void Logger::startBinary(const std::string &basename, size_t ringBytes, off_t rollSize)
+{
+    if (binaryLogging_.load(std::memory_order_acquire) != nullptr)
+    {
+        LOG_ERROR("Logger::startBinary called more than once \n");
+        return;
+    }
+    BinaryLogging *binary = new BinaryLogging(basename, ringBytes, rollSize);
+    binary->start();
+    binaryLogging_.store(binary, std::memory_order_release);
+    binary_.store(true, std::memory_order_release);
+}
+
+void Logger::stopBinary()
+{
+    // 与 stopAsync 相同, 后端对象保留到进程结束
+    BinaryLogging *binary = binaryLogging_.load(std::memory_order_acquire);
+    if (binary)
+    {
+        binary_.store(false, std::memory_order_release);
+        binary->stop();
+    }
+}
+
+void Logger::flush()
+{
+    BinaryLogging *binary = binaryLogging_.load(std::memory_order_acquire);
+    if (binary)
+    {
+        binary->flush();
+    }
+    AsyncLogging *async = async_.load(std::memory_order_acquire);
+    if (async)
+    {
+        async->flush();
+    }
+    fflush(stdout);
 }
\ No newline at end of file
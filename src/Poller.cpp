@@ -1,14 +1,56 @@
+#include <algorithm>
 #include "Poller.h"
 #include "Channel.h"
 
+const int Poller::kNew;
+const int Poller::kAdded;
+const int Poller::kDeleted;
+
 Poller::Poller(EventLoop *loop)
-    : ownerLoop_(loop)
+    : numChannels_(0),
+      ownerLoop_(loop)
 {
 }
 
 bool Poller::hasChannel(Channel *channel) const
 {
-    auto it = channels_.find(channel->fd());
-    // 如果找到的记录存在且对应的Channel对象与传入的channel一致，则返回true。
-    return it != channels_.end() && it->second == channel;
+    size_t fd = static_cast<size_t>(channel->fd());
+    // 如果对应的表项存在且其中的Channel对象与传入的channel一致，则返回true。
+    return fd < channels_.size() && channels_[fd].channel == channel;
+}
+
+Poller::ChannelSlot *Poller::findSlot(const Channel *channel)
+{
+    size_t fd = static_cast<size_t>(channel->fd());
+    return fd < channels_.size() && channels_[fd].channel == channel ? &channels_[fd] : nullptr;
+}
+
+Poller::ChannelSlot &Poller::insertChannel(Channel *channel)
+{
+    size_t fd = static_cast<size_t>(channel->fd());
+    if (fd >= channels_.size())
+    {
+        // 按倍数扩容, 连接数增长时摊还为常数
+        channels_.resize(std::max(fd + 1, channels_.size() * 2));
+    }
+    ChannelSlot &slot = channels_[fd];
+    if (slot.channel == nullptr)
+    {
+        ++numChannels_;
+    }
+    slot.channel = channel;
+    ++slot.generation;
+    slot.state = kNew;
+    return slot;
+}
+
+void Poller::eraseChannel(int fd)
+{
+    size_t idx = static_cast<size_t>(fd);
+    if (idx < channels_.size() && channels_[idx].channel != nullptr)
+    {
+        channels_[idx].channel = nullptr;
+        channels_[idx].state = kNew;
+        --numChannels_;
+    }
 }
\ No newline at end of file
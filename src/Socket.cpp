@@ -1,5 +1,6 @@
 #include "Socket.h"
 
+#include <linux/filter.h>
 #include <netinet/tcp.h>
 #include <strings.h>
 #include <sys/socket.h>
@@ -9,6 +10,17 @@
 #include "InetAddress.h"
 #include "Logger.h"
 
+// 旧版本头文件中可能没有 SO_ZEROCOPY 的定义
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef SO_BUSY_POLL
+#define SO_BUSY_POLL 46
+#endif
+#ifndef SO_ATTACH_REUSEPORT_CBPF
+#define SO_ATTACH_REUSEPORT_CBPF 51
+#endif
+
 Socket::~Socket() { close(sockfd_); }
 
 void Socket::bindAddress(const InetAddress& localaddr)
@@ -72,4 +84,33 @@ void Socket::setKeepAlive(bool on)
 {
     int optval = on ? 1 : 0;
     ::setsockopt(sockfd_, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof optval);
+}
+
+bool Socket::setZeroCopy(bool on)
+{
+    int optval = on ? 1 : 0;
+    return ::setsockopt(sockfd_, SOL_SOCKET, SO_ZEROCOPY, &optval, sizeof optval) == 0;
+}
+
+bool Socket::setBusyPoll(int usec)
+{
+    return ::setsockopt(sockfd_, SOL_SOCKET, SO_BUSY_POLL, &usec, sizeof usec) == 0;
+}
+
+bool Socket::setReusePortCpuSteering(int groupSize)
+{
+    if (groupSize <= 0)
+    {
+        return false;
+    }
+    // A = 当前 CPU 编号; A %= groupSize; 返回 A 作为组内 socket 的序号
+    struct sock_filter code[] = {
+        {BPF_LD | BPF_W | BPF_ABS, 0, 0, static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_CPU)},
+        {BPF_ALU | BPF_MOD | BPF_K, 0, 0, static_cast<uint32_t>(groupSize)},
+        {BPF_RET | BPF_A, 0, 0, 0},
+    };
+    struct sock_fprog prog;
+    prog.len = sizeof code / sizeof code[0];
+    prog.filter = code;
+    return ::setsockopt(sockfd_, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof prog) == 0;
 }
\ No newline at end of file
@@ -2,17 +2,45 @@
 
 #include <errno.h>
 #include <functional>
+#include <limits.h>
+#include <linux/errqueue.h>
+#include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <string>
 #include <strings.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <thread>
+#include <unistd.h>
 
 #include "Channel.h"
 #include "EventLoop.h"
 #include "Logger.h"
 #include "Socket.h"
 
+// 旧版本头文件中可能没有零拷贝相关的定义
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+
+const size_t TcpConnection::kDefaultHighWaterMark;
+const size_t TcpConnection::kMaxSendfileChunk;
+
+// 连接销毁后等待零拷贝完成通知的检查间隔(秒)和最多检查次数, 合计约 10 秒
+const double kZeroCopyLingerInterval = 0.05;
+const int kZeroCopyLingerChecks = 200;
+
+struct TcpConnection::ZeroCopyLinger
+{
+    std::unique_ptr<Socket> socket;  // dup 得到的描述符: 连接关闭自己的 fd 后 socket 仍然打开
+    std::deque<ZeroCopyInflight> inflight;
+    int checksLeft;
+};
+
 // 强制要求传入的 EventLoop* loop (baseLoop) 不能为空
 static EventLoop* CheckLoopNotNull(EventLoop* loop)
 {
@@ -29,11 +57,28 @@ TcpConnection::TcpConnection(EventLoop* loop, const std::string& nameArg, int so
       name_(nameArg),
       state_(kConnecting),
       reading_(true),
+      inputBufferLimit_(0),
+      limitCheckQueued_(false),
+      idleTimeout_(0.0),
       socket_(new Socket(sockfd)),
       channel_(new Channel(loop, sockfd)),
       localAddr_(localAddr),
       peerAddr_(peerAddr),
-      highWaterMark_(64 * 1024 * 1024)  // 64M
+      highWaterMark_(kDefaultHighWaterMark),
+      lowWaterMark_(0),
+      aboveHighWaterMark_(false),
+      shrinkBuffersWhenDrained_(true),
+      autoCork_(false),
+      corkFlushQueued_(false),
+      edgeTriggered_(false),
+      // 发送缓冲区使用分段模式: 大块输出持续堆积时只追加新块, 并用 writev 批量发送
+      outputBuffer_(Buffer::kInitialSize, Buffer::kSegmented),
+      zeroCopyThreshold_(0),
+      zeroCopyNextId_(0),
+      bytesReceived_(0),
+      migrating_(false),
+      callers_(0),
+      replayingOps_(false)
 {
     // 设置 Channel 回调
     channel_->setReadCallback(std::bind(&TcpConnection::handleRead, this, std::placeholders::_1));
@@ -41,49 +86,289 @@ TcpConnection::TcpConnection(EventLoop* loop, const std::string& nameArg, int so
     channel_->setCloseCallback(std::bind(&TcpConnection::handleClose, this));
     channel_->setErrorCallback(std::bind(&TcpConnection::handleError, this));
 
-    LOG_INFO("TcpConnection::ctor[%s] at fd=%d\n", name_.c_str(), sockfd);
+    LOG_DEBUG("TcpConnection::ctor[%s] at fd=%d\n", name_.c_str(), sockfd);
     socket_->setKeepAlive(true);
 }
 
 TcpConnection::~TcpConnection()
 {
-    LOG_INFO("TcpConnection::dtor[%s] at fd=%d state=%d\n", name_.c_str(), channel_->fd(),
-             (int)state_);
+    LOG_DEBUG("TcpConnection::dtor[%s] at fd=%d state=%d\n", name_.c_str(), channel_->fd(),
+              (int)state_);
+    clearPendingOutputs();
+}
+
+void TcpConnection::lingerZeroCopy()
+{
+    // 关闭 socket 之后就读不到完成通知了: 内核仍在引用的零拷贝数据连同 socket 的一个副本交给定时器,
+    // 确认完成后再关闭并释放, 避免内核发出已被释放、甚至被复用的内存
+    reapZeroCopyCompletions(socket_->fd(), &zeroCopyInflight_);
+    if (zeroCopyInflight_.empty())
+    {
+        return;
+    }
+    int fd = ::dup(socket_->fd());
+    if (fd < 0)
+    {
+        // 数据留在连接中, 随连接析构释放
+        LOG_ERROR("TcpConnection::lingerZeroCopy [%s] dup error:%d \n", name_.c_str(), errno);
+        return;
+    }
+    std::shared_ptr<ZeroCopyLinger> linger = std::make_shared<ZeroCopyLinger>();
+    linger->socket.reset(new Socket(fd));
+    linger->inflight.swap(zeroCopyInflight_);
+    linger->checksLeft = kZeroCopyLingerChecks;
+    getLoop()->runAfter(kZeroCopyLingerInterval,
+                        std::bind(&TcpConnection::checkZeroCopyLinger, getLoop(), linger));
+}
+
+void TcpConnection::checkZeroCopyLinger(EventLoop* loop,
+                                        const std::shared_ptr<ZeroCopyLinger>& linger)
+{
+    int fd = linger->socket->fd();
+    reapZeroCopyCompletions(fd, &linger->inflight);
+    if (linger->inflight.empty())
+    {
+        return;  // 定时器回调释放 linger 时关闭 socket
+    }
+    if (--linger->checksLeft > 0)
+    {
+        loop->runAfter(kZeroCopyLingerInterval,
+                       std::bind(&TcpConnection::checkZeroCopyLinger, loop, linger));
+        return;
+    }
+    // 对端长时间不接收: 以 RST 关闭, 内核丢弃发送队列中的数据后再释放用户内存
+    // (应用仍持有连接对象时, socket 要等连接析构关闭最后一个描述符才真正复位)
+    LOG_ERROR("TcpConnection fd=%d zerocopy completions timed out, %lu sends pending, reset \n", fd,
+              linger->inflight.size());
+    struct linger opt = {1, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &opt, sizeof opt);
+    linger->socket.reset();
+    linger->inflight.clear();
+}
+
+bool TcpConnection::setZeroCopyThreshold(size_t threshold)
+{
+    if (threshold > 0 && zeroCopyThreshold_ == 0)
+    {
+        if (!socket_->setZeroCopy(true))
+        {
+            LOG_ERROR("TcpConnection::setZeroCopyThreshold [%s] SO_ZEROCOPY unsupported \n",
+                      name_.c_str());
+            return false;
+        }
+        // 零拷贝完成通知通过错误队列(EPOLLERR)送达
+        channel_->setErrorQueueCallback(std::bind(&TcpConnection::handleErrorQueue, this));
+    }
+    zeroCopyThreshold_ = threshold;
+    return true;
+}
+
+bool TcpConnection::setSocketBusyPoll(int usec)
+{
+    if (!socket_->setBusyPoll(usec))
+    {
+        LOG_ERROR("TcpConnection::setSocketBusyPoll [%s] SO_BUSY_POLL failed:%d \n", name_.c_str(),
+                  errno);
+        return false;
+    }
+    return true;
 }
 
 void TcpConnection::send(const std::string& buf)
 {
     if (state_ == kConnected)
     {
-        if (loop_->isInLoopThread())
+        if (inOwnerLoop())
         {
             sendInLoop(buf.c_str(), buf.size());
         }
         else
         {
-            std::string message = buf;
-            // 此处runInLoop底层仍然是调用queueInLoop
-            loop_->runInLoop(
-                std::bind(&TcpConnection::sendInLoop, this, message.data(), message.size()));
+            // 调用方仍持有 buf, 只能拷贝一份交给所属loop
+            send(Slice(buf.data(), buf.size()));
+        }
+    }
+}
+
+void TcpConnection::send(std::string&& buf)
+{
+    if (state_ == kConnected)
+    {
+        if (inOwnerLoop() && !zeroCopyEligible(buf.size()))
+        {
+            sendInLoop(buf.data(), buf.size());
+        }
+        else
+        {
+            send(Slice(std::move(buf)));
+        }
+    }
+}
+
+void TcpConnection::send(Buffer&& buf)
+{
+    if (state_ == kConnected)
+    {
+        if (inOwnerLoop() && !zeroCopyEligible(buf.readableBytes()))
+        {
+            sendInLoop(buf.peek(), buf.readableBytes());
+            buf.retrieveAll();
+        }
+        else
+        {
+            send(Slice(std::move(buf)));
+        }
+    }
+}
+
+void TcpConnection::send(const Slice& slice)
+{
+    if (state_ == kConnected)
+    {
+        if (inOwnerLoop())
+        {
+            sendSliceInLoop(slice);
+        }
+        else
+        {
+            // slice 保活数据, shared_from_this() 保活连接, 直到所属loop执行完发送
+            runInOwnerLoop(std::bind(&TcpConnection::sendSliceInLoop, shared_from_this(), slice));
+        }
+    }
+}
+
+void TcpConnection::sendSliceInLoop(const Slice& slice)
+{
+    if (migrating_)
+    {
+        staleOps_.push_back(std::bind(&TcpConnection::sendSliceInLoop, shared_from_this(), slice));
+        return;
+    }
+    if (zeroCopyEligible(slice.size()))
+    {
+        sendZeroCopyInLoop(slice);
+    }
+    else
+    {
+        sendInLoop(slice.data(), slice.size());
+    }
+}
+
+void TcpConnection::sendZeroCopyInLoop(const Slice& slice)
+{
+    if (state_ == kDisconnected)
+    {
+        LOG_ERROR("disconnected, give up writing");
+        return;
+    }
+
+    PendingOutput output;
+    output.slice = slice;
+    output.remaining = slice.size();
+    pendingOutputs_.push_back(std::move(output));
+    startPendingOutput();
+}
+
+void TcpConnection::sendv(const struct iovec* iov, int iovcnt)
+{
+    if (state_ == kConnected)
+    {
+        if (inOwnerLoop())
+        {
+            sendvInLoop(iov, iovcnt);
+        }
+        else
+        {
+            // 调用方仍持有各段数据, 只能拼接拷贝一份交给所属loop
+            size_t total = 0;
+            for (int i = 0; i < iovcnt; ++i)
+            {
+                total += iov[i].iov_len;
+            }
+            std::string data;
+            data.reserve(total);
+            for (int i = 0; i < iovcnt; ++i)
+            {
+                data.append(static_cast<const char*>(iov[i].iov_base), iov[i].iov_len);
+            }
+            send(Slice(std::move(data)));
         }
     }
 }
 
+void TcpConnection::sendv(const std::vector<Slice>& slices)
+{
+    if (state_ == kConnected)
+    {
+        if (inOwnerLoop())
+        {
+            sendSlicesInLoop(slices);
+        }
+        else
+        {
+            // 拷贝 vector 只增加每段数据的引用计数
+            runInOwnerLoop(
+                std::bind(&TcpConnection::sendSlicesInLoop, shared_from_this(), slices));
+        }
+    }
+}
+
+void TcpConnection::sendSlicesInLoop(const std::vector<Slice>& slices)
+{
+    if (migrating_)
+    {
+        staleOps_.push_back(
+            std::bind(&TcpConnection::sendSlicesInLoop, shared_from_this(), slices));
+        return;
+    }
+    std::vector<struct iovec> iov(slices.size());
+    for (size_t i = 0; i < slices.size(); ++i)
+    {
+        iov[i].iov_base = const_cast<char*>(slices[i].data());
+        iov[i].iov_len = slices[i].size();
+    }
+    sendvInLoop(iov.data(), static_cast<int>(iov.size()));
+}
+
 void TcpConnection::sendInLoop(const void* data, size_t len)
 {
+    struct iovec iov;
+    iov.iov_base = const_cast<void*>(data);
+    iov.iov_len = len;
+    sendvInLoop(&iov, 1);
+}
+
+void TcpConnection::sendvInLoop(const struct iovec* iov, int iovcnt)
+{
+    size_t len = 0;           // 所有数据段的总长度
     ssize_t nwrote = 0;       // 记录本次发送的字节数
-    size_t remaining = len;   // 记录剩余未发送的字节数，初始为总长度
     bool faultError = false;  // 记录是否发生错误
 
+    for (int i = 0; i < iovcnt; ++i)
+    {
+        len += iov[i].iov_len;
+    }
+    size_t remaining = len;  // 记录剩余未发送的字节数，初始为总长度
+
     if (state_ == kDisconnected)
     {
         LOG_ERROR("disconnected, give up writing");
         return;
     }
     // 当前Channel关注写事件，且发送缓冲区为空，则尝试将数据写入Socket
-    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+    // (自动合并写模式下不立即写, 统一在本轮循环末尾发送)
+    if (!autoCork_ && !channel_->isWriting() && outputBuffer_.readableBytes() == 0 &&
+        pendingOutputs_.empty() && len > 0)
     {
-        nwrote = ::write(channel_->fd(), data, len);
+        if (iovcnt == 1)
+        {
+            nwrote = ::write(channel_->fd(), iov[0].iov_base, iov[0].iov_len);
+        }
+        else
+        {
+            // 超出 IOV_MAX 的段留给下面追加到 outputBuffer_
+            nwrote = ::writev(channel_->fd(), iov, std::min(iovcnt, IOV_MAX));
+        }
         if (nwrote > 0)  // 成功写入nwrote字节
         {
             // 更新剩余字节数
@@ -91,7 +376,7 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
             // 如果全部发送完，就调用写回调
             if (remaining == 0 && writeCompleteCallback_)
             {
-                loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+                getLoop()->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
             }
         }
         else  // 写入出错
@@ -99,7 +384,7 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
             // 因为出错，所以并没有写入任何字节
             nwrote = 0;
             // 检查errno，判断错误类型
-            if (errno != EWOULDBLOCK || errno != EAGAIN)
+            if (errno != EWOULDBLOCK && errno != EAGAIN)
             {
                 LOG_ERROR("TcpConnection::sendInLoop");
                 if (errno == EPIPE || errno == ECONNRESET)
@@ -113,37 +398,399 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
     if (!faultError && remaining > 0)
     {
         // 获取当前缓冲区已有数据量
-        size_t oldlen = outputBuffer_.readableBytes();
-        // 表示本次添加数据后将首次超过高水位线
-        if (oldlen + remaining >= highWaterMark_ && oldlen < highWaterMark_ &&
-            highWaterMarkCallback_)
+        size_t oldlen = bufferedOutputBytes();
+        // 表示本次添加数据后将首次超过高水位线(回落到低水位之前不再重复触发)
+        if (oldlen + remaining >= highWaterMark_ && !aboveHighWaterMark_)
+        {
+            aboveHighWaterMark_ = true;
+            if (highWaterMarkCallback_)
+            {
+                // 触发高水位回调
+                getLoop()->queueInLoop(
+                    std::bind(highWaterMarkCallback_, shared_from_this(), oldlen + remaining));
+            }
+        }
+        // 将未发送的数据(跳过已写入的前nwrote字节)添加到 outputBuffer_末尾
+        // 如果有尚未发送完的文件/零拷贝数据, 则排在它们之后, 保证发送顺序与调用顺序一致
+        Buffer& output =
+            pendingOutputs_.empty() ? outputBuffer_ : pendingOutputs_.back().trailer;
+        size_t skip = nwrote;
+        for (int i = 0; i < iovcnt; ++i)
         {
-            // 触发高水位回调
-            loop_->queueInLoop(
-                std::bind(highWaterMarkCallback_, shared_from_this(), oldlen + remaining));
+            const char* base = static_cast<const char*>(iov[i].iov_base);
+            size_t pieceLen = iov[i].iov_len;
+            if (skip >= pieceLen)
+            {
+                skip -= pieceLen;  // 这一段已全部写入内核
+                continue;
+            }
+            output.append(base + skip, pieceLen - skip);
+            skip = 0;
         }
-        // 将未发送的数据(remaining字节,从 data+nwrote 开始)添加到 outputBuffer_末尾
-        outputBuffer_.append((char*)data + nwrote, remaining);
         if (!channel_->isWriting())  // 如果Channel未关注写事件
         {
-            // 通知Poller关注该connfd的写事件
+            if (autoCork_)
+            {
+                // 登记本轮循环末尾的发送, 本轮后续的 send 都会合并到这一次发送中
+                if (!corkFlushQueued_)
+                {
+                    corkFlushQueued_ = true;
+                    getLoop()->queueFlush(
+                        std::bind(&TcpConnection::flushCorkedOutput, shared_from_this()));
+                }
+            }
+            else
+            {
+                // 通知Poller关注该connfd的写事件(边缘触发模式下只修改逻辑状态)
+                channel_->enableWriting();
+                // 边缘触发模式下部分写入不代表已到 EAGAIN(如超出 IOV_MAX 的段), 继续写到底
+                if (channel_->edgeTriggered() && nwrote > 0)
+                {
+                    handleWrite();
+                }
+            }
+        }
+    }
+}
+
+void TcpConnection::sendFile(int fd, off_t offset, size_t len)
+{
+    if (state_ == kConnected)
+    {
+        // 复制一份文件描述符, 调用方可以在 sendFile 返回后立即关闭自己的 fd
+        int fileFd = ::dup(fd);
+        if (fileFd < 0)
+        {
+            LOG_ERROR("TcpConnection::sendFile dup fd=%d error:%d \n", fd, errno);
+            return;
+        }
+        runInOwnerLoop(std::bind(&TcpConnection::sendFileInLoop, shared_from_this(), fileFd, offset,
+                                 len));
+    }
+}
+
+void TcpConnection::sendFileInLoop(int fileFd, off_t offset, size_t len)
+{
+    if (migrating_)
+    {
+        staleOps_.push_back(std::bind(&TcpConnection::sendFileInLoop, shared_from_this(), fileFd,
+                                      offset, len));
+        return;
+    }
+    if (state_ == kDisconnected)
+    {
+        LOG_ERROR("disconnected, give up sending file");
+        ::close(fileFd);
+        return;
+    }
+
+    PendingOutput output;
+    output.fileFd = fileFd;
+    output.offset = offset;
+    output.remaining = len;
+    pendingOutputs_.push_back(std::move(output));
+    startPendingOutput();
+}
+
+void TcpConnection::startPendingOutput()
+{
+    // 没有排队中的数据: 立即尝试发送, 发送不完的部分交给 handleWrite 继续
+    if (!channel_->isWriting())
+    {
+        int saveErrno = 0;
+        // 内核发送缓冲区已满(EAGAIN)是正常情况, 剩余数据由 handleWrite 继续发送
+        if (writeOutput(&saveErrno) < 0 && saveErrno != EWOULDBLOCK && saveErrno != EAGAIN)
+        {
+            errno = saveErrno;
+            LOG_ERROR("TcpConnection::startPendingOutput");
+            handleError();
+            if (saveErrno == EPIPE || saveErrno == ECONNRESET)
+            {
+                return;  // 连接已失效, 不再关注写事件, 由随后的关闭事件清理
+            }
+        }
+        checkLowWaterMark();
+        if (outputBuffer_.readableBytes() == 0 && pendingOutputs_.empty())
+        {
+            if (writeCompleteCallback_)
+            {
+                getLoop()->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+            }
+        }
+        else
+        {
             channel_->enableWriting();
         }
     }
 }
 
+void TcpConnection::flushCorkedOutput()
+{
+    if (migrating_)
+    {
+        staleOps_.push_back(std::bind(&TcpConnection::flushCorkedOutput, shared_from_this()));
+        return;
+    }
+    corkFlushQueued_ = false;
+    if (state_ == kDisconnected)
+    {
+        return;
+    }
+    // 已在等待可写事件时由 handleWrite 继续发送
+    startPendingOutput();
+    // 数据全部发出后, 处理合并期间发起的关闭
+    if (!channel_->isWriting() && state_ == kDisconnecting)
+    {
+        shutdownInLoop();
+    }
+}
+
+void TcpConnection::checkLowWaterMark()
+{
+    if (aboveHighWaterMark_)
+    {
+        size_t len = bufferedOutputBytes();
+        if (len <= lowWaterMark_)
+        {
+            aboveHighWaterMark_ = false;
+            if (lowWaterMarkCallback_)
+            {
+                getLoop()->queueInLoop(std::bind(lowWaterMarkCallback_, shared_from_this(), len));
+            }
+        }
+    }
+}
+
+ssize_t TcpConnection::writeOutput(int* saveErrno)
+{
+    ssize_t total = 0;
+    for (;;)
+    {
+        // 1. 先发送 outputBuffer_ 中的数据
+        if (outputBuffer_.readableBytes() > 0)
+        {
+            ssize_t n = outputBuffer_.writeFd(channel_->fd(), saveErrno);
+            if (n < 0)
+            {
+                return total > 0 ? total : n;
+            }
+            outputBuffer_.retrieve(n);
+            total += n;
+            if (outputBuffer_.readableBytes() > 0)
+            {
+                // 水平触发: 认为内核发送缓冲区已满, 等待下次可写事件;
+                // 边缘触发: 必须写到 EAGAIN, 否则不会再收到可写通知
+                if (!channel_->edgeTriggered())
+                {
+                    break;
+                }
+                continue;
+            }
+        }
+        // 2. outputBuffer_ 发完后, 发送排在其后的文件或零拷贝数据
+        if (pendingOutputs_.empty())
+        {
+            break;
+        }
+        PendingOutput& output = pendingOutputs_.front();
+        if (output.remaining > 0)
+        {
+            ssize_t n = 0;
+            if (output.fileFd >= 0)
+            {
+                // 文件: 由内核直接把文件内容发往socket
+                size_t chunk = std::min(output.remaining, kMaxSendfileChunk);
+                n = ::sendfile(channel_->fd(), output.fileFd, &output.offset, chunk);
+            }
+            else
+            {
+                // 零拷贝数据: 内核直接引用用户内存, 完成后通过错误队列通知
+                const char* data = output.slice.data() + output.slice.size() - output.remaining;
+                n = ::send(channel_->fd(), data, output.remaining, MSG_ZEROCOPY | MSG_NOSIGNAL);
+                if (n < 0 && errno == ENOBUFS)
+                {
+                    // 超出 optmem 限制: 本次退化为普通拷贝发送
+                    n = ::send(channel_->fd(), data, output.remaining, MSG_NOSIGNAL);
+                }
+                else if (n >= 0)
+                {
+                    // 每次成功的零拷贝发送占用一个序号, 数据需保留到该序号完成
+                    ZeroCopyInflight inflight;
+                    inflight.id = zeroCopyNextId_++;
+                    inflight.slice = output.slice;
+                    zeroCopyInflight_.push_back(std::move(inflight));
+                }
+            }
+            if (n < 0)
+            {
+                *saveErrno = errno;
+                return total > 0 ? total : n;
+            }
+            if (n == 0 && output.fileFd >= 0)
+            {
+                // 文件实际长度小于请求的长度
+                LOG_ERROR("TcpConnection::writeOutput file fd=%d ended with %lu bytes unsent \n",
+                          output.fileFd, output.remaining);
+            }
+            total += n;
+            output.remaining = (n == 0) ? 0 : output.remaining - n;
+        }
+        if (output.remaining > 0)
+        {
+            if (!channel_->edgeTriggered())
+            {
+                break;  // 内核发送缓冲区已满
+            }
+            continue;
+        }
+        // 3. 当前这段输出发送完毕: 关闭文件, 把排在它之后的数据接到 outputBuffer_ 继续发送
+        if (output.fileFd >= 0)
+        {
+            ::close(output.fileFd);
+        }
+        outputBuffer_.swap(output.trailer);
+        pendingOutputs_.pop_front();
+    }
+    return total;
+}
+
+size_t TcpConnection::bufferedOutputBytes() const
+{
+    size_t bytes = outputBuffer_.readableBytes();
+    for (const PendingOutput& output : pendingOutputs_)
+    {
+        bytes += output.trailer.readableBytes();
+    }
+    return bytes;
+}
+
+void TcpConnection::clearPendingOutputs()
+{
+    for (const PendingOutput& output : pendingOutputs_)
+    {
+        if (output.fileFd >= 0)
+        {
+            ::close(output.fileFd);
+        }
+    }
+    pendingOutputs_.clear();
+}
+
 void TcpConnection::shutdown()
 {
     if (state_ == kConnected)
     {
         setState(kDisconnecting);
-        loop_->runInLoop(std::bind(&TcpConnection::shutdownInLoop, this));
+        runInOwnerLoop(std::bind(&TcpConnection::shutdownInLoop, shared_from_this()));
+    }
+}
+
+void TcpConnection::forceClose()
+{
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        setState(kDisconnecting);
+        runInOwnerLoop(std::bind(&TcpConnection::forceCloseInLoop, shared_from_this()), true);
+    }
+}
+
+void TcpConnection::forceCloseInLoop()
+{
+    if (migrating_)
+    {
+        staleOps_.push_back(std::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+        return;
+    }
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        handleClose();
+    }
+}
+
+void TcpConnection::handleIdleTimeout()
+{
+    LOG_INFO("TcpConnection::handleIdleTimeout [%s] idle for %.1f seconds, closing \n",
+             name_.c_str(), idleTimeout_);
+    forceCloseInLoop();
+}
+
+void TcpConnection::startRead()
+{
+    runInOwnerLoop(std::bind(&TcpConnection::startReadInLoop, shared_from_this()));
+}
+
+void TcpConnection::startReadInLoop()
+{
+    if (migrating_)
+    {
+        staleOps_.push_back(std::bind(&TcpConnection::startReadInLoop, shared_from_this()));
+        return;
+    }
+    reading_ = true;
+    updateReadInterest();
+}
+
+void TcpConnection::stopRead()
+{
+    runInOwnerLoop(std::bind(&TcpConnection::stopReadInLoop, shared_from_this()));
+}
+
+void TcpConnection::stopReadInLoop()
+{
+    if (migrating_)
+    {
+        staleOps_.push_back(std::bind(&TcpConnection::stopReadInLoop, shared_from_this()));
+        return;
+    }
+    reading_ = false;
+    updateReadInterest();
+}
+
+void TcpConnection::updateReadInterest()
+{
+    if (state_ != kConnected && state_ != kDisconnecting)
+    {
+        return;
+    }
+    bool overLimit = inputBufferLimit_ > 0 && inputBuffer_.readableBytes() >= inputBufferLimit_;
+    bool wantRead = reading_ && !overLimit;
+    if (wantRead && !channel_->isReading())
+    {
+        channel_->enableReading();
     }
+    else if (!wantRead && channel_->isReading())
+    {
+        channel_->disableReading();
+    }
+    // 积压导致的暂停由连接自己恢复: 应用取走数据不会产生事件, 因此每轮循环末尾检查一次
+    if (reading_ && overLimit && !limitCheckQueued_)
+    {
+        limitCheckQueued_ = true;
+        getLoop()->queueNextFlush(
+            std::bind(&TcpConnection::checkInputBufferLimit, shared_from_this(), getLoop()));
+    }
+}
+
+void TcpConnection::checkInputBufferLimit(EventLoop* loop)
+{
+    // 迁移开始后登记在原loop中的检查作废, 迁移完成时会在新的loop中重新检查
+    if (migrating_ || loop != getLoop())
+    {
+        return;
+    }
+    limitCheckQueued_ = false;
+    updateReadInterest();
 }
 
 void TcpConnection::shutdownInLoop()
 {
-    if (!channel_->isWriting())
+    if (migrating_)
+    {
+        staleOps_.push_back(std::bind(&TcpConnection::shutdownInLoop, shared_from_this()));
+        return;
+    }
+    // 还有数据等待发送(关注写事件或等待本轮合并写)时, 由发送完成的一方负责关闭写端
+    if (!channel_->isWriting() && !corkFlushQueued_)
     {
         socket_->shutdownWrite();
     }
@@ -153,45 +800,255 @@ void TcpConnection::shutdownInLoop()
 void TcpConnection::connectEstablished()
 {
     setState(kConnected);
+    // 连接数只在所属loop中维护: 建立时加一, connectDestroyed 中减一, 迁移时在两个loop之间转移
+    getLoop()->metrics().addConnections(1);
     // 解决 Channel 和 TCPConnection 之间潜在的生命周期问题
     channel_->tie(shared_from_this());
+    channel_->setEdgeTriggered(edgeTriggered_ && getLoop()->supportsEdgeTriggered());
     channel_->enableReading();
+    if (idleTimeout_ > 0.0)
+    {
+        // 连接销毁前一定会先从时间轮中移除, 因此回调中可以直接使用 this
+        idleEntry_.setCallback(std::bind(&TcpConnection::handleIdleTimeout, this));
+        getLoop()->timingWheel()->schedule(&idleEntry_, idleTimeout_);
+    }
 
     connectionCallback_(shared_from_this());
 }
 // 连接断开
 void TcpConnection::connectDestroyed()
 {
+    if (migrating_)
+    {
+        staleOps_.push_back(std::bind(&TcpConnection::connectDestroyed, shared_from_this()));
+        return;
+    }
     if (state_ == kConnected)
     {
         setState(kDisconnected);
         channel_->disableAll();
         connectionCallback_(shared_from_this());
     }
+    if (idleEntry_.linked())
+    {
+        getLoop()->timingWheel()->cancel(&idleEntry_);
+    }
     channel_->remove();
+    // 连接已关闭, 不会再有新的零拷贝发送
+    if (!zeroCopyInflight_.empty())
+    {
+        lingerZeroCopy();
+    }
+    getLoop()->metrics().addConnections(-1);
+}
+
+void TcpConnection::destroy(bool queue)
+{
+    runInOwnerLoop(std::bind(&TcpConnection::connectDestroyed, shared_from_this()), queue);
+}
+
+bool TcpConnection::inOwnerLoop() const
+{
+    return !migrating_.load() && getLoop()->isInLoopThread();
+}
+
+void TcpConnection::runInOwnerLoop(Functor op, bool queue)
+{
+    // 先登记再检查 migrating_: 迁移一方先置 migrating_ 再等待 callers_ 归零,
+    // 两者都是顺序一致的原子操作, 因此不会有线程在迁移开始后仍向原loop投递
+    callers_.fetch_add(1);
+    if (!migrating_.load())
+    {
+        EventLoop* loop = getLoop();
+        if (!queue && loop->isInLoopThread())
+        {
+            callers_.fetch_sub(1);
+            op();
+        }
+        else
+        {
+            loop->queueInLoop(std::move(op));
+            callers_.fetch_sub(1);
+        }
+        return;
+    }
+    callers_.fetch_sub(1);
+
+    std::unique_lock<std::mutex> lock(migrateMutex_);
+    if (migrating_)
+    {
+        migrationBacklog_.push_back(std::move(op));
+        return;
+    }
+    // 迁移刚好结束, 按新的 loop_ 投递
+    lock.unlock();
+    runInOwnerLoop(std::move(op), queue);
+}
+
+void TcpConnection::migrateTo(EventLoop* loop, const MigrateCallback& cb)
+{
+    // 总是排队执行: 不能在连接自身的事件回调中途摘除它的 Channel
+    runInOwnerLoop(std::bind(&TcpConnection::migrateInLoop, shared_from_this(), loop, cb), true);
+}
+
+void TcpConnection::migrateInLoop(EventLoop* loop, const MigrateCallback& cb)
+{
+    if (migrating_)
+    {
+        // 上一次迁移尚未完成, 完成后在新的loop中继续
+        staleOps_.push_back(std::bind(&TcpConnection::migrateInLoop, shared_from_this(), loop, cb));
+        return;
+    }
+    if (replayingOps_)
+    {
+        // 刚迁移过来, 至少先在新的loop中处理一轮事件, 否则连续的迁移请求会让连接一直无法读写
+        getLoop()->queueInLoop(
+            std::bind(&TcpConnection::migrateInLoop, shared_from_this(), loop, cb));
+        return;
+    }
+    if (state_ != kConnected || loop == getLoop())
+    {
+        if (cb)
+        {
+            cb(shared_from_this(), state_ == kConnected);
+        }
+        return;
+    }
+    LOG_DEBUG("TcpConnection::migrateInLoop [%s] fd=%d %p -> %p \n", name_.c_str(),
+              channel_->fd(), getLoop(), loop);
+
+    // 1. 停止在原loop中处理事件, 之后到达的数据留在内核接收缓冲区中
+    channel_->disableAll();
+    channel_->remove();
+    limitCheckQueued_ = false;  // 原loop中登记的检查作废
+    bool idle = idleEntry_.linked();
+    if (idle)
+    {
+        getLoop()->timingWheel()->cancel(&idleEntry_);
+    }
+
+    // 2. 之后发起的操作都暂存; 等正在按旧的 loop_ 投递的线程完成投递
+    migrating_ = true;
+    while (callers_.load() != 0)
+    {
+        std::this_thread::yield();
+    }
+
+    // 3. 在此之前投递到原loop的操作都排在交接之前, 执行时会进入 staleOps_
+    getLoop()->queueInLoop(
+        std::bind(&TcpConnection::migrateHandoff, shared_from_this(), loop, idle, cb));
+}
+
+void TcpConnection::migrateHandoff(EventLoop* loop, bool idle, const MigrateCallback& cb)
+{
+    // 原loop中不会再有这个连接的操作, 把 Channel 和连接交给新的loop
+    channel_->setOwnerLoop(loop);
+    getLoop()->metrics().addConnections(-1);
+    loop->metrics().addConnections(1);
+    loop_.store(loop, std::memory_order_release);
+    loop->queueInLoop(std::bind(&TcpConnection::connectMigrated, shared_from_this(), idle, cb));
+}
+
+void TcpConnection::connectMigrated(bool idle, const MigrateCallback& cb)
+{
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        channel_->setEdgeTriggered(edgeTriggered_ && getLoop()->supportsEdgeTriggered());
+        updateReadInterest();
+        if (outputBuffer_.readableBytes() > 0 || !pendingOutputs_.empty())
+        {
+            channel_->enableWriting();
+        }
+        if (idle)
+        {
+            getLoop()->timingWheel()->schedule(&idleEntry_, idleTimeout_);
+        }
+    }
+
+    // 按调用顺序重放暂存的操作: 先是迁移开始前投递到原loop的, 再是迁移期间发起的
+    std::vector<Functor> staleOps;
+    staleOps.swap(staleOps_);
+    std::vector<Functor> backlog;
+    {
+        std::lock_guard<std::mutex> lock(migrateMutex_);
+        backlog.swap(migrationBacklog_);
+        migrating_ = false;
+    }
+    replayingOps_ = true;
+    for (const Functor& op : staleOps)
+    {
+        op();
+    }
+    for (const Functor& op : backlog)
+    {
+        op();
+    }
+    replayingOps_ = false;
+    if (cb)
+    {
+        cb(shared_from_this(), true);
+    }
 }
 
 void TcpConnection::handleRead(Timestamp receiveTime)
 //当 Poller 检测到 connfd 变为可读时，Channel会调用此方法
+{
+    // 边缘触发模式下必须一直读到 EAGAIN, 否则剩余数据不会再次触发读事件
+    const bool edgeTriggered = channel_->edgeTriggered();
+    do
+    {
+        if (!handleReadOnce(receiveTime, edgeTriggered))
+        {
+            break;
+        }
+        // 暂停读取(积压达到上限)或连接已关闭时停止, 恢复读取时 epoll_ctl 会重新报告就绪
+    } while (edgeTriggered && channel_->isReading() && state_ != kDisconnected);
+}
+
+bool TcpConnection::handleReadOnce(Timestamp receiveTime, bool edgeTriggered)
 {
     int saveErrno = 0;
     // 从 connfd 读取数据，并将数据存入 inputBuffer_。
     ssize_t n = inputBuffer_.readFd(channel_->fd(), &saveErrno);
     if (n > 0)  // 成功读取数据
     {
+        bytesReceived_.store(bytesReceived_.load(std::memory_order_relaxed) + n,
+                             std::memory_order_relaxed);
+        // 刷新空闲超时, 只更新截止时间, O(1)
+        if (idleEntry_.linked())
+        {
+            getLoop()->timingWheel()->schedule(&idleEntry_, idleTimeout_);
+        }
         // 这是网络库使用者最关心的回调之一(通常对应 onMessage)。
         messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+        // 用户已处理完全部数据: 归还接收缓冲区的存储区, 下次有数据时再从内存池取
+        if (shrinkBuffersWhenDrained_ && inputBuffer_.readableBytes() == 0)
+        {
+            inputBuffer_.shrink(0);
+        }
+        // 积压达到上限时暂停读取
+        if (inputBufferLimit_ > 0)
+        {
+            updateReadInterest();
+        }
     }
     else if (n == 0)  // 对端关闭连接
     {
         handleClose();
+        return false;
+    }
+    else if (edgeTriggered && (saveErrno == EAGAIN || saveErrno == EWOULDBLOCK))  // 已读空
+    {
+        return false;
     }
     else  // 发送错误
     {
         errno = saveErrno;
         LOG_ERROR("TcpConnection::handleRead");
         handleError();
+        return false;
     }
+    return true;
 }
 
 void TcpConnection::handleWrite()
@@ -202,21 +1059,24 @@ void TcpConnection::handleWrite()
     if (channel_->isWriting())
     {
         int saveErrno = 0;
-        // 将 outputBuffer_ 中缓存的数据写入 connfd
-        ssize_t n = outputBuffer_.writeFd(channel_->fd(), &saveErrno);
-        if (n > 0)  // 成功写入部分或全部数据
+        // 将 outputBuffer_ 中缓存的数据以及排队的文件写入 connfd
+        ssize_t n = writeOutput(&saveErrno);
+        if (n >= 0)  // 成功写入部分或全部数据
         {
-            // 移除已成功发送的数据
-            outputBuffer_.retrieve(n);
-            if (outputBuffer_.readableBytes() == 0)
+            checkLowWaterMark();
+            if (outputBuffer_.readableBytes() == 0 && pendingOutputs_.empty())
             // 数据全部发送完毕
             {
                 // 告知 Channel 不再需要关注写事件
                 channel_->disableWriting();
+                if (shrinkBuffersWhenDrained_)
+                {
+                    outputBuffer_.shrink(0);
+                }
                 if (writeCompleteCallback_)
                 {
                     // 防御性编程，确保在下轮事件循环执行回调
-                    loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+                    getLoop()->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
                 }
                 if (state_ == kDisconnecting)  // 如果正在断开连接，则关闭连接
                 {
@@ -227,6 +1087,7 @@ void TcpConnection::handleWrite()
         }
         else  // 写入失败
         {
+            errno = saveErrno;
             LOG_ERROR("TcpConnection::handleWrite");
         }
     }
@@ -238,12 +1099,18 @@ void TcpConnection::handleWrite()
 
 void TcpConnection::handleClose()
 {
-    LOG_INFO("TcpConnection::handleClose fd=%d state=%d \n", channel_->fd(), (int)state_);
+    LOG_DEBUG("TcpConnection::handleClose fd=%d state=%d \n", channel_->fd(), (int)state_);
     // 将连接状态更新为已断开
     setState(kDisconnected);
     // 移除 Channel
     channel_->disableAll();
     channel_->remove();
+    // 尚未发送的文件和零拷贝数据不再发送
+    clearPendingOutputs();
+    if (idleEntry_.linked())
+    {
+        getLoop()->timingWheel()->cancel(&idleEntry_);
+    }
     // 执行连接断开回调函数
     TcpConnectionPtr connPtr(shared_from_this());
     connectionCallback_(connPtr);
@@ -264,4 +1131,58 @@ void TcpConnection::handleError()
         err = optval;
     }
     LOG_ERROR("TcpConnection::handleError name:%s - SO_ERROR:%d \n", name_.c_str(), err);
+}
+
+bool TcpConnection::handleErrorQueue()
+{
+    return reapZeroCopyCompletions(channel_->fd(), &zeroCopyInflight_);
+}
+
+bool TcpConnection::reapZeroCopyCompletions(int fd, std::deque<ZeroCopyInflight>* inflight)
+{
+    bool notified = false;
+    for (;;)
+    {
+        char control[128];
+        struct msghdr msg;
+        ::bzero(&msg, sizeof msg);
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof control;
+        if (::recvmsg(fd, &msg, MSG_ERRQUEUE) < 0)
+        {
+            break;  // EAGAIN: 错误队列已读空
+        }
+
+        for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm))
+        {
+            if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+                  (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)))
+            {
+                continue;
+            }
+            const struct sock_extended_err* serr =
+                reinterpret_cast<const struct sock_extended_err*>(CMSG_DATA(cm));
+            if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+            {
+                continue;
+            }
+            // 序号区间 [ee_info, ee_data] 内的发送已完成, 内核不再引用对应数据
+            uint32_t lo = serr->ee_info;
+            uint32_t hi = serr->ee_data;
+            for (ZeroCopyInflight& sent : *inflight)
+            {
+                if (sent.id - lo <= hi - lo)
+                {
+                    sent.slice = Slice();
+                }
+            }
+            notified = true;
+        }
+    }
+    // 完成通知基本按序到达, 从队头弹出已释放的数据
+    while (!inflight->empty() && inflight->front().slice.empty())
+    {
+        inflight->pop_front();
+    }
+    return notified;
 }
\ No newline at end of file
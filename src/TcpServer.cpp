@@ -1,11 +1,39 @@
 #include "TcpServer.h"
 
+#include <condition_variable>
+#include <errno.h>
 #include <functional>
+#include <mutex>
 #include <strings.h>
 
 #include "Logger.h"
 #include "TcpConnection.h"
 
+// 最忙和最闲的 Sub Loop 忙碌占比相差超过该值, 且迁移能把差距缩小至少该值时才迁移连接
+const double kRebalanceThreshold = 0.2;
+
+namespace
+{
+// 析构 TcpServer 时等待各个 loop 析构完自己的 Acceptor
+struct AcceptorTeardown
+{
+    std::mutex mutex;
+    std::condition_variable cond;
+    size_t remaining;
+};
+}  // namespace
+
+// 在 Acceptor 所属的loop中析构它: 之后该loop不会再处理监听socket的事件, 也就不会再回调 TcpServer
+static void destroyAcceptor(Acceptor* acceptor, AcceptorTeardown* teardown)
+{
+    delete acceptor;
+    std::lock_guard<std::mutex> lock(teardown->mutex);
+    if (--teardown->remaining == 0)
+    {
+        teardown->cond.notify_one();
+    }
+}
+
 // 强制要求传入的 EventLoop* loop (baseLoop) 不能为空
 static EventLoop* CheckLoopNotNull(EventLoop* loop)
 {
@@ -21,53 +49,155 @@ TcpServer::TcpServer(EventLoop* loop, const InetAddress& listenAddr, const std::
     : loop_(CheckLoopNotNull(loop)),
       ipPort_(listenAddr.toIpPort()),
       name_(nameArg),
+      listenAddr_(listenAddr),
       // 将loop(baseLoop)传递给Acceptor，明确Acceptor在baseLoop中执行
       // 将监听地址(listenAddr)传递给 Acceptor，用于后续的 socket, bind, listen 操作
-      // 根据 option 决定是否设置 SO_REUSEPORT 选项
-      acceptor_(new Acceptor(loop, listenAddr, option == kReusePort)),
+      // 根据 option 决定是否设置 SO_REUSEPORT 选项; kReusePortPerLoop 模式下在 start() 中为每个 loop 创建
+      acceptor_(option == kReusePortPerLoop ? nullptr
+                                            : new Acceptor(loop, listenAddr, option == kReusePort)),
+      reusePortCpuSteering_(false),
+      acceptBatch_(Acceptor::kDefaultAcceptBatch),
       // 此处只创建线程池对象，还未启动任何IO线程(subLoop)
       threadPool_(new EventLoopThreadPool(loop, name_)),
       connectionCallback_(),
       messageCallback_(),
+      highWaterMark_(TcpConnection::kDefaultHighWaterMark),
+      lowWaterMark_(0),
+      shrinkBuffersWhenDrained_(true),
+      zeroCopyThreshold_(0),
+      autoCork_(false),
+      edgeTriggered_(false),
+      inputBufferLimit_(0),
+      idleTimeout_(0.0),
+      socketBusyPollUs_(0),
+      rebalanceInterval_(0.0),
       nextConnId_(1),
       started_(0)
 {
-    acceptor_->setNewConnectionCallback(
-        std::bind(&TcpServer::newConnection, this, std::placeholders::_1, std::placeholders::_2));
+    if (acceptor_)
+    {
+        acceptor_->setNewConnectionCallback(std::bind(&TcpServer::newConnection, this,
+                                                      std::placeholders::_1, std::placeholders::_2));
+    }
 }
 
 TcpServer::~TcpServer()
 {
+    loop_->cancel(rebalanceTimer_);
+    // 各个 loop 的 Acceptor 在其所属loop中析构, 并等待全部完成: 在此之前这些loop仍可能接受新连接,
+    // 通过 createConnection 使用 this
+    AcceptorTeardown teardown;
+    teardown.remaining = loopAcceptors_.size();
+    for (std::unique_ptr<Acceptor>& acceptor : loopAcceptors_)
+    {
+        EventLoop* ioLoop = acceptor->ownerLoop();
+        ioLoop->runInLoop(std::bind(&destroyAcceptor, acceptor.release(), &teardown));
+    }
+    {
+        std::unique_lock<std::mutex> lock(teardown.mutex);
+        while (teardown.remaining > 0)
+        {
+            teardown.cond.wait(lock);
+        }
+    }
     // 遍历并关闭所有连接
+    std::lock_guard<std::mutex> lock(connectionsMutex_);
     for (auto& item : connections_)
     {
         TcpConnectionPtr conn(item.second);  // 获取连接的shared_ptr
         item.second.reset();  // 置空shared_ptr，断开TcpServer对TcpConnection对象的强引用
-        conn->getLoop()->runInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+        // 不能直接向 conn->getLoop() 投递: 连接可能正在迁移, 由连接自己投递到迁移后的 loop
+        conn->destroy(false);
     }
 }
 
 void TcpServer::setThreadNum(int numThreads) { threadPool_->setThreadNum(numThreads); }
 
+void TcpServer::setAcceptBatch(int n)
+{
+    acceptBatch_ = n;
+    if (acceptor_)
+    {
+        acceptor_->setAcceptBatch(n);
+    }
+}
+
+Acceptor::Stats TcpServer::acceptStats() const
+{
+    Acceptor::Stats total = acceptor_ ? acceptor_->stats() : Acceptor::Stats();
+    for (const std::unique_ptr<Acceptor>& acceptor : loopAcceptors_)
+    {
+        Acceptor::Stats s = acceptor->stats();
+        total.wakeups += s.wakeups;
+        total.accepted += s.accepted;
+        total.batchFull += s.batchFull;
+        total.rejected += s.rejected;
+        total.errors += s.errors;
+    }
+    return total;
+}
+
 void TcpServer::start()
 {
     // 防止重复启动
     if (started_++ == 0)
     {
         threadPool_->start(threadInitCallback_);
-        loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get()));
+        if (acceptor_)
+        {
+            loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get()));
+        }
+        else
+        {
+            startLoopAcceptors();
+        }
+        if (rebalanceInterval_ > 0.0)
+        {
+            rebalanceTimer_ =
+                loop_->runEvery(rebalanceInterval_, std::bind(&TcpServer::rebalance, this));
+        }
+    }
+}
+
+void TcpServer::startLoopAcceptors()
+{
+    std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+    for (EventLoop* ioLoop : loops)
+    {
+        Acceptor* acceptor = new Acceptor(ioLoop, listenAddr_, true);
+        acceptor->setAcceptBatch(acceptBatch_);
+        acceptor->setNewConnectionCallback(std::bind(&TcpServer::createConnection, this, ioLoop,
+                                                     std::placeholders::_1, std::placeholders::_2));
+        loopAcceptors_.emplace_back(acceptor);
+    }
+    // SO_REUSEPORT 组内 socket 的序号即 listen 的顺序, 在这里依次 listen, 使第 i 个 socket 属于第 i 个 loop
+    for (std::unique_ptr<Acceptor>& acceptor : loopAcceptors_)
+    {
+        acceptor->listenSocket();
+    }
+    if (reusePortCpuSteering_ &&
+        !loopAcceptors_.front()->setReusePortCpuSteering(static_cast<int>(loopAcceptors_.size())))
+    {
+        LOG_ERROR("TcpServer::start [%s] - SO_ATTACH_REUSEPORT_CBPF failed:%d \n", name_.c_str(),
+                  errno);
+    }
+    for (std::unique_ptr<Acceptor>& acceptor : loopAcceptors_)
+    {
+        acceptor->ownerLoop()->runInLoop(std::bind(&Acceptor::listen, acceptor.get()));
     }
 }
 
 void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr)
 {
-    // 轮询获取一个subLoop，以管理channel
-    EventLoop* ioLoop = threadPool_->getNextLoop();
+    // 按负载均衡策略获取一个subLoop，以管理channel
+    createConnection(threadPool_->getNextLoop(peerAddr), sockfd, peerAddr);
+}
 
+void TcpServer::createConnection(EventLoop* ioLoop, int sockfd, const InetAddress& peerAddr)
+{
     // 生成连接名称
     char buf[64] = {0};
-    snprintf(buf, sizeof(buf), "-%s#%d", ipPort_.c_str(), nextConnId_);
-    ++nextConnId_;
+    snprintf(buf, sizeof(buf), "-%s#%d", ipPort_.c_str(), nextConnId_++);
     std::string connName = name_ + buf;
 
     LOG_INFO("TcpServer::newConnection [%s] - new connection [%s] from %s\n", name_.c_str(),
@@ -85,12 +215,30 @@ void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr)
 
     // 创建TcpConnection对象
     TcpConnectionPtr conn(new TcpConnection(ioLoop, connName, sockfd, localAddr, peerAddr));
-    // 存储新连接
-    connections_[connName] = conn;
+    // 存储新连接(kReusePortPerLoop 模式下在各个 loop 中调用, 因此加锁)
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex_);
+        connections_[connName] = conn;
+    }
     // 设置TcpConnection回调
     conn->setConnectionCallback(connectionCallback_);
     conn->setMessageCallback(messageCallback_);
     conn->setWriteCompleteCallback(writeCompleteCallback_);
+    conn->setHighWaterMarkCallback(highWaterMarkCallback_, highWaterMark_);
+    conn->setLowWaterMarkCallback(lowWaterMarkCallback_, lowWaterMark_);
+    conn->setShrinkBuffersWhenDrained(shrinkBuffersWhenDrained_);
+    conn->setAutoCork(autoCork_);
+    conn->setEdgeTriggered(edgeTriggered_);
+    conn->setInputBufferLimit(inputBufferLimit_);
+    conn->setIdleTimeout(idleTimeout_);
+    if (socketBusyPollUs_ > 0)
+    {
+        conn->setSocketBusyPoll(socketBusyPollUs_);
+    }
+    if (zeroCopyThreshold_ > 0)
+    {
+        conn->setZeroCopyThreshold(zeroCopyThreshold_);
+    }
     // 设置内部关闭回调
     conn->setCloseCallback(std::bind(&TcpServer::removeConnection, this, std::placeholders::_1));
 
@@ -109,9 +257,98 @@ void TcpServer::removeConnectionInLoop(const TcpConnectionPtr& conn)
     LOG_INFO("TcpServer::removeConnectionInLoop [%s] - connection %s\n", name_.c_str(),
              conn->name().c_str());
     // 从map中删除
-    connections_.erase(conn->name());
-    // 获取连接所属的subLoop
-    EventLoop* ioLoop = conn->getLoop();
-    // 删除连接
-    ioLoop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex_);
+        connections_.erase(conn->name());
+    }
+    // 在连接所属的subLoop中删除连接(排队执行, 此时可能仍在连接的事件回调中)
+    conn->destroy();
+}
+
+void TcpServer::rebalance()
+{
+    std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+    std::vector<double> utilizations = threadPool_->getRecentUtilizations();
+    if (utilizations.size() < 2)
+    {
+        return;
+    }
+
+    // 1. 各连接自上次以来的接收量
+    std::unordered_map<std::string, uint64_t> bytes;
+    std::vector<std::pair<TcpConnectionPtr, uint64_t>> recent;
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex_);
+        bytes.reserve(connections_.size());
+        recent.reserve(connections_.size());
+        for (const auto& item : connections_)
+        {
+            uint64_t total = item.second->bytesReceived();
+            auto last = rebalanceBytes_.find(item.first);
+            recent.emplace_back(item.second,
+                                total - (last != rebalanceBytes_.end() ? last->second : 0));
+            bytes[item.first] = total;
+        }
+    }
+    rebalanceBytes_.swap(bytes);
+
+    // 2. 最忙和最闲的 loop 相差不大时不迁移
+    size_t hot = 0;
+    size_t cool = 0;
+    for (size_t i = 1; i < utilizations.size(); ++i)
+    {
+        if (utilizations[i] > utilizations[hot])
+        {
+            hot = i;
+        }
+        if (utilizations[i] < utilizations[cool])
+        {
+            cool = i;
+        }
+    }
+    double gap = utilizations[hot] - utilizations[cool];
+    if (gap < kRebalanceThreshold)
+    {
+        return;
+    }
+
+    // 3. 按接收量把最忙 loop 的忙碌占比分摊到它的各个连接上, 迁走负载为 share 的连接后两边相差
+    // |gap - 2 * share|; 选择迁移后两边最接近的一个, 且差距至少缩小 kRebalanceThreshold,
+    // 避免来回迁移唯一的热点连接或反复迁移几乎没有负载的连接
+    uint64_t hotBytes = 0;
+    for (const auto& item : recent)
+    {
+        if (item.first->getLoop() == loops[hot])
+        {
+            hotBytes += item.second;
+        }
+    }
+    if (hotBytes == 0)
+    {
+        return;
+    }
+    TcpConnectionPtr best;
+    double bestDistance = (gap - kRebalanceThreshold) / 2;
+    for (const auto& item : recent)
+    {
+        if (item.first->getLoop() != loops[hot] || item.second == 0)
+        {
+            continue;
+        }
+        double share = utilizations[hot] * static_cast<double>(item.second) / hotBytes;
+        double distance = share > gap / 2 ? share - gap / 2 : gap / 2 - share;
+        if (distance < bestDistance)
+        {
+            best = item.first;
+            bestDistance = distance;
+        }
+    }
+    if (best)
+    {
+        LOG_INFO("TcpServer::rebalance [%s] - move connection [%s] from loop %zu (%.0f%%) to loop "
+                 "%zu (%.0f%%)\n",
+                 name_.c_str(), best->name().c_str(), hot, utilizations[hot] * 100, cool,
+                 utilizations[cool] * 100);
+        best->migrateTo(loops[cool]);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,195 @@
+#include "TimerQueue.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <iterator>
+#include <stdint.h>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "EventLoop.h"
+#include "Logger.h"
+#include "Timer.h"
+#include "TimerId.h"
+
+// 创建 timerfd, 使用单调时钟, 不受系统时间调整的影响
+static int createTimerfd()
+{
+    int timerfd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timerfd < 0)
+    {
+        LOG_FATAL("timerfd_create error:%d \n", errno);
+    }
+    return timerfd;
+}
+
+// 计算从现在到 when 的时间间隔
+static struct timespec howMuchTimeFromNow(Timestamp when)
+{
+    int64_t microseconds = when.microSecondsSinceEpoch() - Timestamp::now().microSecondsSinceEpoch();
+    // 已经过期的定时器也要让 timerfd 尽快触发, 0 会解除 timerfd, 因此至少设置 100 微秒
+    if (microseconds < 100)
+    {
+        microseconds = 100;
+    }
+    struct timespec ts;
+    ts.tv_sec = static_cast<time_t>(microseconds / Timestamp::kMicroSecondsPerSecond);
+    ts.tv_nsec = static_cast<long>((microseconds % Timestamp::kMicroSecondsPerSecond) * 1000);
+    return ts;
+}
+
+// 读走 timerfd 上的超时次数, 否则在 LT 模式下会一直触发
+static void readTimerfd(int timerfd)
+{
+    uint64_t howmany;
+    ssize_t n = ::read(timerfd, &howmany, sizeof howmany);
+    if (n != sizeof howmany)
+    {
+        LOG_ERROR("TimerQueue::handleRead() reads %ld bytes instead of 8 \n", n);
+    }
+}
+
+// 把 timerfd 的到期时间设置为 expiration
+static void resetTimerfd(int timerfd, Timestamp expiration)
+{
+    struct itimerspec newValue;
+    struct itimerspec oldValue;
+    ::memset(&newValue, 0, sizeof newValue);
+    ::memset(&oldValue, 0, sizeof oldValue);
+    newValue.it_value = howMuchTimeFromNow(expiration);
+    if (::timerfd_settime(timerfd, 0, &newValue, &oldValue) < 0)
+    {
+        LOG_ERROR("timerfd_settime error:%d \n", errno);
+    }
+}
+
+TimerQueue::TimerQueue(EventLoop* loop)
+    : loop_(loop),
+      timerfd_(createTimerfd()),
+      timerfdChannel_(loop, timerfd_),
+      callingExpiredTimers_(false)
+{
+    timerfdChannel_.setReadCallback(std::bind(&TimerQueue::handleRead, this));
+    timerfdChannel_.enableReading();
+}
+
+TimerQueue::~TimerQueue()
+{
+    timerfdChannel_.disableAll();
+    timerfdChannel_.remove();
+    ::close(timerfd_);
+    for (const Entry& timer : timers_)
+    {
+        delete timer.second;
+    }
+}
+
+TimerId TimerQueue::addTimer(TimerCallback cb, Timestamp when, double interval)
+{
+    Timer* timer = new Timer(std::move(cb), when, interval);
+    loop_->runInLoop(std::bind(&TimerQueue::addTimerInLoop, this, timer));
+    return TimerId(timer, timer->sequence());
+}
+
+void TimerQueue::cancel(TimerId timerId)
+{
+    loop_->runInLoop(std::bind(&TimerQueue::cancelInLoop, this, timerId));
+}
+
+void TimerQueue::addTimerInLoop(Timer* timer)
+{
+    bool earliestChanged = insert(timer);
+    if (earliestChanged)
+    {
+        resetTimerfd(timerfd_, timer->expiration());
+    }
+}
+
+void TimerQueue::cancelInLoop(TimerId timerId)
+{
+    ActiveTimer timer(timerId.timer_, timerId.sequence_);
+    ActiveTimerSet::iterator it = activeTimers_.find(timer);
+    if (it != activeTimers_.end())
+    {
+        timers_.erase(Entry(it->first->expiration(), it->first));
+        delete it->first;
+        activeTimers_.erase(it);
+    }
+    else if (callingExpiredTimers_)
+    {
+        // 定时器正在执行(或已到期等待执行), 记下来, 避免重复定时器被重新插入
+        cancelingTimers_.insert(timer);
+    }
+}
+
+void TimerQueue::handleRead()
+{
+    Timestamp now(Timestamp::now());
+    readTimerfd(timerfd_);
+
+    std::vector<Entry> expired = getExpired(now);
+
+    callingExpiredTimers_ = true;
+    cancelingTimers_.clear();
+    for (const Entry& it : expired)
+    {
+        it.second->run();
+    }
+    callingExpiredTimers_ = false;
+
+    reset(expired, now);
+}
+
+std::vector<TimerQueue::Entry> TimerQueue::getExpired(Timestamp now)
+{
+    std::vector<Entry> expired;
+    // 第一个到期时间大于 now 的定时器(地址取最大值, 保证到期时间等于 now 的定时器都被取出)
+    Entry sentry(now, reinterpret_cast<Timer*>(UINTPTR_MAX));
+    TimerList::iterator end = timers_.lower_bound(sentry);
+    std::copy(timers_.begin(), end, std::back_inserter(expired));
+    timers_.erase(timers_.begin(), end);
+
+    for (const Entry& it : expired)
+    {
+        activeTimers_.erase(ActiveTimer(it.second, it.second->sequence()));
+    }
+    return expired;
+}
+
+void TimerQueue::reset(const std::vector<Entry>& expired, Timestamp now)
+{
+    for (const Entry& it : expired)
+    {
+        ActiveTimer timer(it.second, it.second->sequence());
+        // 重复定时器且回调执行期间未被取消, 则计算下次到期时间并重新插入
+        if (it.second->repeat() && cancelingTimers_.find(timer) == cancelingTimers_.end())
+        {
+            it.second->restart(now);
+            insert(it.second);
+        }
+        else
+        {
+            delete it.second;
+        }
+    }
+
+    if (!timers_.empty())
+    {
+        resetTimerfd(timerfd_, timers_.begin()->second->expiration());
+    }
+}
+
+bool TimerQueue::insert(Timer* timer)
+{
+    bool earliestChanged = false;
+    Timestamp when = timer->expiration();
+    TimerList::iterator it = timers_.begin();
+    if (it == timers_.end() || when < it->first)
+    {
+        earliestChanged = true;
+    }
+    timers_.insert(Entry(when, timer));
+    activeTimers_.insert(ActiveTimer(timer, timer->sequence()));
+    return earliestChanged;
+}
\ No newline at end of file
@@ -1,7 +1,10 @@
 #include "Timestamp.h"
 
+#include <sys/time.h>
 #include <time.h>
 
+const int Timestamp::kMicroSecondsPerSecond;
+
 Timestamp::Timestamp() : microSecondsSinceEpoch_(0) {}
 
 Timestamp::Timestamp(int64_t microSecondsSinceEpoch)
@@ -11,13 +14,16 @@ Timestamp::Timestamp(int64_t microSecondsSinceEpoch)
 
 Timestamp Timestamp::now()
 {
-    return Timestamp(time(NULL));
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return Timestamp(static_cast<int64_t>(tv.tv_sec) * kMicroSecondsPerSecond + tv.tv_usec);
 }
 
 std::string Timestamp::toString() const
 {
     char buf[128] = {0};
-    tm *tm_time = localtime(&microSecondsSinceEpoch_);
+    time_t seconds = static_cast<time_t>(microSecondsSinceEpoch_ / kMicroSecondsPerSecond);
+    tm *tm_time = localtime(&seconds);
     snprintf(buf, 128, "%4d/%02d/%02d %02d:%02d:%02d",
              tm_time->tm_year + 1900, // tm_year 是从 1900 年开始计数的
              tm_time->tm_mon + 1,     // tm_mon 是从 0 开始计数的
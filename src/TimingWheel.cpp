@@ -0,0 +1,156 @@
+#include "TimingWheel.h"
+
+#include <math.h>
+
+#include "EventLoop.h"
+
+const int TimingWheel::kDefaultNumSlots;
+const int TimingWheel::kExpiredSlot;
+
+TimingWheel::Entry::~Entry()
+{
+    if (wheel_)
+    {
+        wheel_->cancel(this);
+    }
+}
+
+TimingWheel::TimingWheel(EventLoop* loop, double tickSeconds, int numSlots)
+    : loop_(loop),
+      tickSeconds_(tickSeconds),
+      slots_(numSlots, nullptr),
+      expired_(nullptr),
+      currentTick_(0),
+      size_(0),
+      ticking_(false)
+{
+}
+
+TimingWheel::~TimingWheel()
+{
+    if (ticking_)
+    {
+        loop_->cancel(tickTimer_);
+    }
+    // 剩余节点与时间轮脱离关系, 避免它们析构时访问已销毁的时间轮
+    for (size_t i = 0; i < slots_.size(); ++i)
+    {
+        while (slots_[i])
+        {
+            unlink(slots_[i]);
+        }
+    }
+}
+
+void TimingWheel::schedule(Entry* entry, double timeout)
+{
+    // 向上取整, 再多等一格: 当前这一格可能马上就要结束
+    uint64_t ticks = static_cast<uint64_t>(::ceil(timeout / tickSeconds_)) + 1;
+    entry->deadline_ = currentTick_ + ticks;
+    if (entry->linked())
+    {
+        // 所在槽下一次到期时再检查截止时间: 只要新的截止时间不早于它, 节点就留在原来的槽中
+        if (entry->slot_ != kExpiredSlot)
+        {
+            uint64_t numSlots = slots_.size();
+            uint64_t distance = (entry->slot_ + numSlots - currentTick_ % numSlots) % numSlots;
+            uint64_t nextVisit = currentTick_ + (distance == 0 ? numSlots : distance);
+            if (entry->deadline_ >= nextVisit)
+            {
+                return;
+            }
+        }
+        // 截止时间提前了, 或节点已在本轮到期链表中(回调执行前被刷新): 挪到新截止时间对应的槽
+        unlink(entry);
+    }
+    link(entry, static_cast<int>(entry->deadline_ % slots_.size()));
+    if (!ticking_)
+    {
+        ticking_ = true;
+        tickTimer_ = loop_->runEvery(tickSeconds_, std::bind(&TimingWheel::onTick, this));
+    }
+}
+
+void TimingWheel::cancel(Entry* entry)
+{
+    if (entry->wheel_ == this)
+    {
+        unlink(entry);
+    }
+}
+
+void TimingWheel::onTick()
+{
+    ++currentTick_;
+    int slot = static_cast<int>(currentTick_ % slots_.size());
+
+    // 先把本槽中真正到期的节点移到 expired_ 链表, 未到期的挂到截止时间对应的槽
+    Entry* entry = slots_[slot];
+    while (entry)
+    {
+        Entry* next = entry->next_;
+        unlink(entry);
+        if (entry->deadline_ <= currentTick_)
+        {
+            link(entry, kExpiredSlot);
+        }
+        else
+        {
+            link(entry, static_cast<int>(entry->deadline_ % slots_.size()));
+        }
+        entry = next;
+    }
+
+    // 逐个取出并执行回调, 回调中可以安全地移除或重新加入任意节点
+    while (expired_)
+    {
+        entry = expired_;
+        unlink(entry);
+        if (entry->callback_)
+        {
+            entry->callback_();
+        }
+    }
+
+    // 时间轮空了就停下定时器, 避免空闲loop被周期性唤醒
+    if (size_ == 0 && ticking_)
+    {
+        ticking_ = false;
+        loop_->cancel(tickTimer_);
+    }
+}
+
+void TimingWheel::link(Entry* entry, int slot)
+{
+    Entry*& first = head(slot);
+    entry->wheel_ = this;
+    entry->slot_ = slot;
+    entry->prev_ = nullptr;
+    entry->next_ = first;
+    if (first)
+    {
+        first->prev_ = entry;
+    }
+    first = entry;
+    ++size_;
+}
+
+void TimingWheel::unlink(Entry* entry)
+{
+    if (entry->prev_)
+    {
+        entry->prev_->next_ = entry->next_;
+    }
+    else
+    {
+        head(entry->slot_) = entry->next_;
+    }
+    if (entry->next_)
+    {
+        entry->next_->prev_ = entry->prev_;
+    }
+    entry->wheel_ = nullptr;
+    entry->prev_ = nullptr;
+    entry->next_ = nullptr;
+    --size_;
+}
\ No newline at end of file
@@ -0,0 +1,396 @@
+// 二进制日志解码工具: 把 Logger::startBinary() 写出的文件还原成文本日志
+// 用法: mymuduo_logdecode 文件...
+// 输出格式: [级别]YYYY/MM/DD HH:MM:SS.uuuuuu tid : 消息
+// 同一线程的日志保持写入顺序, 不同线程的日志按后台线程的搬运批次交错
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <map>
+#include <string>
+
+#include "Logger.h"
+
+namespace
+{
+const char* const kLevelNames[] = {"[DEBUG]", "[INFO]", "[ERROR]", "[FATAL]"};
+
+struct Site
+{
+    int level;
+    int line;
+    std::string format;
+    std::string file;
+};
+
+// 顺序读取文件内容, 越界时 ok() 变为 false
+class Reader
+{
+   public:
+    Reader(const char* data, size_t len) : data_(data), len_(len), pos_(0), ok_(true) {}
+
+    bool ok() const { return ok_; }
+    bool done() const { return pos_ >= len_; }
+    size_t position() const { return pos_; }
+
+    template <typename T>
+    T read()
+    {
+        T value = T();
+        const char* p = take(sizeof value);
+        if (p)
+        {
+            memcpy(&value, p, sizeof value);
+        }
+        return value;
+    }
+    std::string readString(size_t n)
+    {
+        const char* p = take(n);
+        return p ? std::string(p, n) : std::string();
+    }
+    const char* take(size_t n)
+    {
+        if (!ok_ || len_ - pos_ < n)
+        {
+            ok_ = false;
+            return nullptr;
+        }
+        const char* p = data_ + pos_;
+        pos_ += n;
+        return p;
+    }
+
+   private:
+    const char* data_;
+    size_t len_;
+    size_t pos_;
+    bool ok_;
+};
+
+// 一个编码后的参数
+struct Arg
+{
+    char type;
+    int64_t i;
+    uint64_t u;
+    double d;
+    std::string s;
+};
+
+bool readArg(Reader& args, Arg* arg)
+{
+    arg->type = args.read<char>();
+    switch (arg->type)
+    {
+        case BinaryLogging::kIntArg:
+            arg->i = args.read<int64_t>();
+            arg->u = static_cast<uint64_t>(arg->i);
+            arg->d = static_cast<double>(arg->i);
+            break;
+        case BinaryLogging::kUintArg:
+        case BinaryLogging::kPointerArg:
+            arg->u = args.read<uint64_t>();
+            arg->i = static_cast<int64_t>(arg->u);
+            arg->d = static_cast<double>(arg->u);
+            break;
+        case BinaryLogging::kDoubleArg:
+            arg->d = args.read<double>();
+            arg->i = static_cast<int64_t>(arg->d);
+            arg->u = static_cast<uint64_t>(arg->i);
+            break;
+        case BinaryLogging::kStringArg:
+            arg->s = args.readString(args.read<uint16_t>());
+            break;
+        default:
+            return false;
+    }
+    return args.ok();
+}
+
+// 用一个参数格式化一个转换说明, spec 为去掉长度修饰符的 "%[flags][width][.precision]"
+void formatOne(std::string& out, std::string spec, char conv, const Arg& arg)
+{
+    char buf[4096];
+    int n = 0;
+    switch (conv)
+    {
+        case 'd':
+        case 'i':
+        case 'c':
+            if (conv == 'c')
+            {
+                spec += 'c';
+                n = snprintf(buf, sizeof buf, spec.c_str(), static_cast<int>(arg.i));
+            }
+            else
+            {
+                spec += "lld";
+                n = snprintf(buf, sizeof buf, spec.c_str(), static_cast<long long>(arg.i));
+            }
+            break;
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+            spec += "ll";
+            spec += conv;
+            n = snprintf(buf, sizeof buf, spec.c_str(), static_cast<unsigned long long>(arg.u));
+            break;
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            spec += conv;
+            n = snprintf(buf, sizeof buf, spec.c_str(), arg.d);
+            break;
+        case 'p':
+            spec += 'p';
+            n = snprintf(buf, sizeof buf, spec.c_str(), reinterpret_cast<void*>(arg.u));
+            break;
+        case 's':
+            if (arg.type == BinaryLogging::kStringArg)
+            {
+                spec += 's';
+                n = snprintf(buf, sizeof buf, spec.c_str(), arg.s.c_str());
+            }
+            else
+            {
+                n = snprintf(buf, sizeof buf, "<bad %%s arg>");
+            }
+            break;
+        default:
+            n = snprintf(buf, sizeof buf, "<bad conversion %%%c>", conv);
+            break;
+    }
+    if (n > 0)
+    {
+        out.append(buf, static_cast<size_t>(n) < sizeof buf ? n : sizeof buf - 1);
+    }
+}
+
+// 按 printf 格式字符串和编码后的参数还原消息
+std::string formatMessage(const std::string& format, Reader& args)
+{
+    std::string out;
+    Arg arg;
+    for (size_t i = 0; i < format.size(); ++i)
+    {
+        if (format[i] != '%')
+        {
+            out.push_back(format[i]);
+            continue;
+        }
+        if (i + 1 < format.size() && format[i + 1] == '%')
+        {
+            out.push_back('%');
+            ++i;
+            continue;
+        }
+
+        // %[flags][width][.precision][length]conversion, 宽度和精度为 * 时从参数中取
+        std::string spec("%");
+        size_t j = i + 1;
+        while (j < format.size() && strchr("-+ #0", format[j]))
+        {
+            spec += format[j++];
+        }
+        for (int part = 0; part < 2 && j < format.size(); ++part)
+        {
+            if (part == 1)
+            {
+                if (format[j] != '.')
+                {
+                    break;
+                }
+                spec += format[j++];
+            }
+            if (j < format.size() && format[j] == '*')
+            {
+                ++j;
+                spec += readArg(args, &arg) ? std::to_string(arg.i) : "0";
+            }
+            while (j < format.size() && format[j] >= '0' && format[j] <= '9')
+            {
+                spec += format[j++];
+            }
+        }
+        // 整数参数统一按 64 位编码, 长度修饰符在重建时改写
+        while (j < format.size() && strchr("hlLqjzt", format[j]))
+        {
+            ++j;
+        }
+        if (j >= format.size())
+        {
+            out.append(format, i, std::string::npos);
+            break;
+        }
+        char conv = format[j];
+        if (conv == 'n')
+        {
+            // 不支持 %n, 也没有对应的参数
+        }
+        else if (readArg(args, &arg))
+        {
+            formatOne(out, spec, conv, arg);
+        }
+        else
+        {
+            out += "<missing arg>";
+        }
+        i = j;
+    }
+    return out;
+}
+
+void formatTime(char* buf, size_t len, int64_t micros)
+{
+    time_t seconds = static_cast<time_t>(micros / 1000000);
+    struct tm tm_time;
+    ::localtime_r(&seconds, &tm_time);
+    snprintf(buf, len, "%4d/%02d/%02d %02d:%02d:%02d.%06d", tm_time.tm_year + 1900,
+             tm_time.tm_mon + 1, tm_time.tm_mday, tm_time.tm_hour, tm_time.tm_min,
+             tm_time.tm_sec, static_cast<int>(micros % 1000000));
+}
+
+bool readFile(const char* filename, std::string* content)
+{
+    FILE* fp = ::fopen(filename, "rb");
+    if (fp == nullptr)
+    {
+        ::fprintf(stderr, "cannot open %s: %s\n", filename, ::strerror(errno));
+        return false;
+    }
+    char buf[64 * 1024];
+    size_t n = 0;
+    while ((n = ::fread(buf, 1, sizeof buf, fp)) > 0)
+    {
+        content->append(buf, n);
+    }
+    ::fclose(fp);
+    return true;
+}
+
+// 解码一个文件, 成功返回 true
+bool decode(const char* filename)
+{
+    std::string content;
+    if (!readFile(filename, &content))
+    {
+        return false;
+    }
+    Reader reader(content.data(), content.size());
+    const char* magic = reader.take(sizeof BinaryLogging::kMagic);
+    if (magic == nullptr || memcmp(magic, BinaryLogging::kMagic, sizeof BinaryLogging::kMagic) != 0)
+    {
+        ::fprintf(stderr, "%s: not a binary log file\n", filename);
+        return false;
+    }
+
+    std::map<uint32_t, Site> sites;
+    while (!reader.done())
+    {
+        size_t recordStart = reader.position();
+        // 同一秒内滚动的文件同名, 新的文件头会追加在旧文件之后
+        if (content.size() - recordStart >= sizeof BinaryLogging::kMagic &&
+            memcmp(content.data() + recordStart, BinaryLogging::kMagic,
+                   sizeof BinaryLogging::kMagic) == 0)
+        {
+            reader.take(sizeof BinaryLogging::kMagic);
+            continue;
+        }
+        char type = reader.read<char>();
+        if (type == BinaryLogging::kSiteRecord)
+        {
+            uint32_t id = reader.read<uint32_t>();
+            Site& site = sites[id];
+            site.level = reader.read<uint8_t>();
+            site.line = static_cast<int>(reader.read<uint32_t>());
+            site.format = reader.readString(reader.read<uint16_t>());
+            site.file = reader.readString(reader.read<uint16_t>());
+        }
+        else if (type == BinaryLogging::kLogRecord)
+        {
+            uint32_t tid = reader.read<uint32_t>();
+            uint32_t id = reader.read<uint32_t>();
+            int64_t micros = reader.read<int64_t>();
+            uint32_t argsLen = reader.read<uint32_t>();
+            const char* argsData = reader.take(argsLen);
+            if (!reader.ok())
+            {
+                break;
+            }
+
+            char timebuf[64];
+            formatTime(timebuf, sizeof timebuf, micros);
+            std::map<uint32_t, Site>::const_iterator it = sites.find(id);
+            if (it == sites.end())
+            {
+                ::printf("[?]%s %u : <unknown log site %u>\n", timebuf, tid, id);
+                continue;
+            }
+            const Site& site = it->second;
+            Reader args(argsData, argsLen);
+            std::string message = formatMessage(site.format, args);
+            // 格式字符串中常带有结尾的换行
+            while (!message.empty() && message.back() == '\n')
+            {
+                message.pop_back();
+            }
+            const char* level = site.level >= DEBUG && site.level <= FATAL
+                                    ? kLevelNames[site.level]
+                                    : "[?]";
+            ::printf("%s%s %u : %s\n", level, timebuf, tid, message.c_str());
+        }
+        else if (type == BinaryLogging::kDropRecord)
+        {
+            uint32_t tid = reader.read<uint32_t>();
+            uint64_t count = reader.read<uint64_t>();
+            if (reader.ok())
+            {
+                ::printf("[DROPPED] %u : %" PRIu64 " records dropped (ring full)\n", tid, count);
+            }
+        }
+        else
+        {
+            ::fprintf(stderr, "%s: bad record type 0x%02x at offset %zu\n", filename,
+                      static_cast<unsigned char>(type), recordStart);
+            return false;
+        }
+        if (!reader.ok())
+        {
+            break;
+        }
+    }
+    if (!reader.ok())
+    {
+        // 进程异常退出时文件末尾可能只写了半条记录
+        ::fprintf(stderr, "%s: truncated record at end of file\n", filename);
+    }
+    return true;
+}
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        ::fprintf(stderr, "usage: %s file...\n", argv[0]);
+        return 1;
+    }
+    int ret = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!decode(argv[i]))
+        {
+            ret = 1;
+        }
+    }
+    return ret;
+}
\ No newline at end of file